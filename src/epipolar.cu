@@ -0,0 +1,369 @@
+// Kernels for depth search along epipolar lines:
+#include "epipolar.cu.h"
+#include <helper_structs.h>
+#include "dev_functions.h"
+
+__device__ inline
+bool sample_epipolar(float & value, const float * __restrict__ d_data, const float3 p, const int width, const int height)
+{
+    if (p.z <= 0.f) return false;
+    const float x = p.x / p.z - 1, y = p.y / p.z - 1;
+    const int ix = floorf(x), iy = floorf(y);
+    if ((ix < 0) || (iy < 0) || (ix + 1 > width - 1) || (iy + 1 > height - 1)) return false;
+    const float * d = d_data + iy * width + ix;
+    value = bilinterp(make_float2(d[0], d[1]), make_float2(d[width], d[width + 1]), make_float2(x - ix, y - iy));
+    return true;
+}
+
+__device__ inline
+float2 epipolar_direction(const EpipolarParams & params, const int x, const int y)
+{
+    // Direction from epipole to pixel, valid also for epipole at infinity
+    const float3 e = params.epipole;
+    float2 dir = make_float2((x + 1) * e.z - e.x, (y + 1) * e.z - e.y);
+    const float len = length(dir);
+    return len > 0.f ? dir / len : make_float2(1.f, 0.f);
+}
+
+// Only gradient along epipolar line gives depth information, pixel must not lie on image border
+__device__ inline
+float epipolar_gradient(const float * __restrict__ d_ref, const EpipolarParams & params, const int x, const int y,
+                        const int width)
+{
+    const int ind = y * width + x;
+    const float2 grad = make_float2(d_ref[ind + 1] - d_ref[ind - 1], d_ref[ind + width] - d_ref[ind - width]) * .5f;
+    return fabsf(dot(grad, epipolar_direction(params, x, y)));
+}
+
+/**
+ *  \brief Search inverse depth range along epipolar lines for best matching inverse depth
+ *
+ *  \param idepth   best inverse depth returned by reference
+ *  \param istd     inverse depth uncertainty returned by reference
+ *  \param ncc      NCC of best match returned by reference
+ *  \param d_ref    pointer to reference image
+ *  \param params   cameras and source views
+ *  \param x        reference pixel x coordinate
+ *  \param y        reference pixel y coordinate
+ *  \param qmin     smallest inverse depth to search
+ *  \param qmax     largest inverse depth to search
+ *  \param width    image width
+ *  \param height   image height
+ *  \return True if unique match with NCC above threshold was found
+ */
+__device__
+bool epipolar_search(float & idepth, float & istd, float & ncc, const float * __restrict__ d_ref,
+                     const EpipolarParams & params, const int x, const int y, const float qmin, const float qmax,
+                     const int width, const int height)
+{
+    const int r = EPIPOLAR_PATCH_SIZE / 2;
+    const float2 dir = epipolar_direction(params, x, y);
+
+    // Reference patch along reference epipolar line
+    float3 pk[EPIPOLAR_PATCH_SIZE];
+    float vr[EPIPOLAR_PATCH_SIZE];
+    float mr = 0.f, sr = 0.f;
+    for (int k = -r; k <= r; k++){
+        pk[k + r] = make_float3(x + 1 + k * dir.x, y + 1 + k * dir.y, 1.f);
+        if (!sample_epipolar(vr[k + r], d_ref, pk[k + r], width, height)) return false;
+        mr += vr[k + r];
+    }
+    mr /= EPIPOLAR_PATCH_SIZE;
+    for (int k = 0; k < EPIPOLAR_PATCH_SIZE; k++){
+        vr[k] -= mr;
+        sr += vr[k] * vr[k];
+    }
+    if (sr < EPIPOLAR_PATCH_SIZE * params.stdthresh * params.stdthresh) return false;
+
+    // Number of samples from longest epipolar segment
+    const float3 p = make_float3(x + 1, y + 1, 1.f);
+    float len = 0.f;
+    for (int s = 0; s < params.nsrc; s++){
+        const float3 a = params.A[s] * p;
+        const float3 s0 = a + qmin * params.b[s], s1 = a + qmax * params.b[s];
+        if ((s0.z <= 0.f) || (s1.z <= 0.f)) continue;
+        len = fmaxf(len, length(make_float2(s1.x / s1.z - s0.x / s0.z, s1.y / s1.z - s0.y / s0.z)));
+    }
+    const int n = min(max((int)ceilf(len), 2), EPIPOLAR_MAX_STEPS);
+    const float step = (qmax - qmin) / (n - 1);
+
+    // Best and second best score, second best is taken away from best sample, NCC of best sample neighbours
+    float best = -2.f, second = -2.f, prev = -2.f, below = -2.f, above = -2.f;
+    int ibest = -1;
+
+    for (int i = 0; i < n; i++){
+        const float q = qmin + i * step;
+
+        // NCC averaged over source views which see the whole patch
+        float score = 0.f;
+        int valid = 0;
+        for (int s = 0; s < params.nsrc; s++){
+            float vs[EPIPOLAR_PATCH_SIZE], ms = 0.f, ss = 0.f, sc = 0.f;
+            bool inside = true;
+            for (int k = 0; k < EPIPOLAR_PATCH_SIZE && inside; k++){
+                inside = sample_epipolar(vs[k], params.src[s], params.A[s] * pk[k] + q * params.b[s], width, height);
+                ms += vs[k];
+            }
+            if (!inside) continue;
+            ms /= EPIPOLAR_PATCH_SIZE;
+            for (int k = 0; k < EPIPOLAR_PATCH_SIZE; k++){
+                ss += (vs[k] - ms) * (vs[k] - ms);
+                sc += vr[k] * (vs[k] - ms);
+            }
+            score += ss > 0.f ? sc * rsqrtf(sr * ss) : 0.f;
+            valid++;
+        }
+        score = valid ? score / valid : -2.f;
+
+        if (score > best){
+            if (i - ibest > 2) second = fmaxf(second, best);
+            below = prev;
+            above = -2.f;
+            best = score;
+            ibest = i;
+        }
+        else {
+            if (i == ibest + 1) above = score;
+            if (i - ibest > 2) second = fmaxf(second, score);
+        }
+        prev = score;
+    }
+
+    // Reject weak and ambiguous matches
+    if ((ibest < 0) || (best < params.nccthresh) || (second > EPIPOLAR_UNIQUENESS * best)) return false;
+
+    // Parabola fit around best sample
+    float offset = 0.f;
+    if ((ibest > 0) && (ibest < n - 1) && (below > -2.f) && (above > -2.f)){
+        const float denom = below - 2.f * best + above;
+        if (denom < 0.f) offset = fminf(fmaxf(.5f * (below - above) / denom, -.5f), .5f);
+    }
+
+    idepth = qmin + (ibest + offset) * step;
+    istd = .5f * step;
+    ncc = best;
+    return idepth > 0.f;
+}
+
+__global__ void semidense_depth_kernel(float * __restrict__ d_depth, float * __restrict__ d_ncc,
+                                       unsigned char * __restrict__ d_mask, const float * __restrict__ d_ref,
+                                       const EpipolarParams params, const float gradthresh,
+                                       const float znear, const float zfar,
+                                       const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        d_depth[ind] = 0.f;
+        d_ncc[ind] = -1.f;
+        d_mask[ind] = 0;
+
+        if ((ind_x < 1) || (ind_y < 1) || (ind_x > width - 2) || (ind_y > height - 2)) return;
+
+        if (epipolar_gradient(d_ref, params, ind_x, ind_y, width) < gradthresh) return;
+
+        float idepth, istd, ncc;
+        if (epipolar_search(idepth, istd, ncc, d_ref, params, ind_x, ind_y, 1.f / zfar, 1.f / znear, width, height)){
+            d_depth[ind] = 1.f / idepth;
+            d_ncc[ind] = ncc;
+            d_mask[ind] = 1;
+        }
+    }
+}
+
+void semidense_depth(float * d_depth, float * d_ncc, unsigned char * d_mask, const float * d_ref,
+                     const EpipolarParams & params, const float gradthresh, const float znear, const float zfar,
+                     const int width, const int height, dim3 blocks, dim3 threads)
+{
+    semidense_depth_kernel<<<blocks, threads>>>(d_depth, d_ncc, d_mask, d_ref, params, gradthresh,
+                                                znear, zfar, width, height);
+}
+
+__global__ void depth_filter_init_kernel(float4 * __restrict__ d_state, const float qmin, const float qmax,
+                                         const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const float range = qmax - qmin;
+        d_state[ind] = make_float4(qmin + .5f * range, range * range / 36, DEPTH_FILTER_INIT_AB, DEPTH_FILTER_INIT_AB);
+    }
+}
+
+void depth_filter_init(float4 * d_state, const float qmin, const float qmax,
+                       const int width, const int height, dim3 blocks, dim3 threads)
+{
+    depth_filter_init_kernel<<<blocks, threads>>>(d_state, qmin, qmax, width, height);
+}
+
+__device__ inline
+bool depth_filter_transfer(int & ind_new, float & q_new, const float4 state, const Matrix3D & A, const float3 b,
+                           const int x, const int y, const int width, const int height)
+{
+    // Pixel at inverse depth q maps to A p + q b in new keyframe, depth there is z / q
+    const float3 p = A * make_float3(x + 1, y + 1, 1.f) + state.x * b;
+    if ((state.x <= 0.f) || (p.z <= 0.f)) return false;
+    const int nx = floorf(p.x / p.z - .5f), ny = floorf(p.y / p.z - .5f);
+    if ((nx < 0) || (ny < 0) || (nx > width - 1) || (ny > height - 1)) return false;
+    ind_new = ny * width + nx;
+    q_new = state.x / p.z;
+    return true;
+}
+
+__global__ void depth_filter_splat_kernel(float * __restrict__ d_nearest, const float4 * __restrict__ d_state,
+                                          const Matrix3D A, const float3 b, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        int ind_new;
+        float q_new;
+        // positive floats compare the same as their bit patterns, largest inverse depth is nearest
+        if (depth_filter_transfer(ind_new, q_new, d_state[ind_y * width + ind_x], A, b, ind_x, ind_y, width, height))
+            atomicMax((int *)d_nearest + ind_new, __float_as_int(q_new));
+    }
+}
+
+__global__ void depth_filter_propagate_kernel(float4 * __restrict__ d_state_new, const float * __restrict__ d_nearest,
+                                              const float4 * __restrict__ d_state, const Matrix3D A, const float3 b,
+                                              const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const float4 state = d_state[ind_y * width + ind_x];
+        int ind_new;
+        float q_new;
+        if (depth_filter_transfer(ind_new, q_new, state, A, b, ind_x, ind_y, width, height) &&
+            (d_nearest[ind_new] == q_new)){
+            // Inverse depth scales with depth ratio, motion adds process noise
+            const float scale = q_new / state.x;
+            const float noise = DEPTH_FILTER_PROCESS_NOISE * q_new;
+            d_state_new[ind_new] = make_float4(q_new, state.y * scale * scale + noise * noise, state.z, state.w);
+        }
+    }
+}
+
+void depth_filter_propagate(float4 * d_state_new, float * d_nearest, const float4 * d_state,
+                            const Matrix3D & A, const float3 & b,
+                            const int width, const int height, dim3 blocks, dim3 threads)
+{
+    depth_filter_splat_kernel<<<blocks, threads>>>(d_nearest, d_state, A, b, width, height);
+    depth_filter_propagate_kernel<<<blocks, threads>>>(d_state_new, d_nearest, d_state, A, b, width, height);
+}
+
+__device__ inline
+bool depth_filter_active_state(const float4 state, const float qmin, const float qmax)
+{
+    // Converged and diverged pixels are no longer searched
+    const float range = qmax - qmin;
+    return (state.y >= DEPTH_FILTER_CONVERGED_STD * DEPTH_FILTER_CONVERGED_STD * range * range) &&
+           (state.z / (state.z + state.w) >= DEPTH_FILTER_MIN_INLIER);
+}
+
+__global__ void depth_filter_active_kernel(int * __restrict__ d_active, unsigned int * __restrict__ d_count,
+                                           const float4 * __restrict__ d_state, const float qmin, const float qmax,
+                                           const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        if ((ind_x < 1) || (ind_y < 1) || (ind_x > width - 2) || (ind_y > height - 2)) return;
+
+        const int ind = ind_y * width + ind_x;
+        if (depth_filter_active_state(d_state[ind], qmin, qmax)) d_active[atomicAdd(d_count, 1)] = ind;
+    }
+}
+
+void depth_filter_active(int * d_active, unsigned int * d_count, const float4 * d_state,
+                         const float qmin, const float qmax,
+                         const int width, const int height, dim3 blocks, dim3 threads)
+{
+    depth_filter_active_kernel<<<blocks, threads>>>(d_active, d_count, d_state, qmin, qmax, width, height);
+}
+
+__device__ inline
+bool depth_filter_update_pixel(float4 * __restrict__ d_state, const float * __restrict__ d_ref,
+                               const EpipolarParams & params, const float gradthresh,
+                               const float qmin, const float qmax,
+                               const int ind_x, const int ind_y, const int width, const int height)
+{
+    const int ind = ind_y * width + ind_x;
+    float4 state = d_state[ind];
+    float mu = state.x, s2 = state.y, a = state.z, b = state.w;
+    const float range = qmax - qmin;
+    const float inlier = a / (a + b);
+
+    // Pixel stays active until epipolar line has enough gradient
+    if (epipolar_gradient(d_ref, params, ind_x, ind_y, width) < gradthresh) return true;
+
+    // Search within confidence interval of current estimate
+    const float s = sqrtf(s2);
+    const float lo = fmaxf(mu - DEPTH_FILTER_SEARCH_STD * s, qmin);
+    const float hi = fminf(mu + DEPTH_FILTER_SEARCH_STD * s, qmax);
+
+    float x, xstd, ncc;
+    if (!epipolar_search(x, xstd, ncc, d_ref, params, ind_x, ind_y, lo, hi, width, height)){
+        state.w = b + 1.f;
+        d_state[ind].w = state.w;
+        return depth_filter_active_state(state, qmin, qmax);
+    }
+
+    // Gaussian x Uniform update of inverse depth and inlier ratio
+    const float tau2 = xstd * xstd;
+    const float s2n = 1.f / (1.f / s2 + 1.f / tau2);
+    const float m = s2n * (mu / s2 + x / tau2);
+    const float d2 = s2 + tau2;
+    float c1 = inlier * rsqrtf(6.2831853f * d2) * expf(-.5f * (x - mu) * (x - mu) / d2);
+    float c2 = (1.f - inlier) / range;
+    const float norm = c1 + c2;
+    c1 /= norm;
+    c2 /= norm;
+
+    const float f = c1 * (a + 1.f) / (a + b + 1.f) + c2 * a / (a + b + 1.f);
+    const float e = c1 * (a + 1.f) * (a + 2.f) / ((a + b + 1.f) * (a + b + 2.f)) +
+                    c2 * a * (a + 1.f) / ((a + b + 1.f) * (a + b + 2.f));
+
+    const float mu_new = c1 * m + c2 * mu;
+    state.y = fmaxf(c1 * (s2n + m * m) + c2 * (s2 + mu * mu) - mu_new * mu_new, 1e-12f);
+    state.x = mu_new;
+    state.z = (e - f) / (f - e / f);
+    state.w = state.z * (1.f - f) / f;
+    d_state[ind] = state;
+    return depth_filter_active_state(state, qmin, qmax);
+}
+
+__global__ void depth_filter_update_kernel(float4 * __restrict__ d_state, const float * __restrict__ d_ref,
+                                           const EpipolarParams params, const float gradthresh,
+                                           const float qmin, const float qmax,
+                                           const int * __restrict__ d_active, const unsigned int nactive,
+                                           int * __restrict__ d_next, unsigned int * __restrict__ d_nnext,
+                                           const int width, const int height)
+{
+    const unsigned int i = threadIdx.x + blockDim.x * blockIdx.x;
+
+    if (i < nactive) {
+        const int ind = d_active[i];
+        if (depth_filter_update_pixel(d_state, d_ref, params, gradthresh, qmin, qmax,
+                                      ind % width, ind / width, width, height))
+            d_next[atomicAdd(d_nnext, 1)] = ind;
+    }
+}
+
+void depth_filter_update(float4 * d_state, const float * d_ref, const EpipolarParams & params,
+                         const float gradthresh, const float qmin, const float qmax,
+                         const int * d_active, const unsigned int nactive, int * d_next, unsigned int * d_nnext,
+                         const int width, const int height, dim3 threads)
+{
+    if (nactive == 0) return;
+    const unsigned int n = threads.x * threads.y;
+    depth_filter_update_kernel<<<(nactive + n - 1) / n, n>>>(d_state, d_ref, params, gradthresh, qmin, qmax,
+                                                             d_active, nactive, d_next, d_nnext, width, height);
+}
@@ -4,7 +4,8 @@
 
 template<unsigned char _bins>
 __global__ void FusionUpdateHistogram_kernel(fusionData<_bins> f, const float * __restrict__ depthmap, const Matrix3D K,
-                                             const Matrix3D R, const Vector3D T, const float threshold, const int width, const int height)
+                                             const Matrix3D R, const Vector3D T, const float threshold, const int width, const int height,
+                                             const float * __restrict__ confidence, const float minconfidence)
 {
     int3 i = f.indexes(getGlobalIdx());
 
@@ -34,6 +35,10 @@ __global__ void FusionUpdateHistogram_kernel(fusionData<_bins> f, const float *
         float2 y0 = make_float2(depthmap[pxc.x+pxc.y*width], depthmap[pxc1.x+pxc.y*width]); // values at (x,y) and (x+1,y)
         float2 y1 = make_float2(depthmap[pxc.x+pxc1.y*width], depthmap[pxc1.x+pxc1.y*width]); // values at (x,y+1) and (x+1,y+1)
 
+        // Skip depths interpolated from low confidence pixels
+        if (confidence && (fminf(fminf(confidence[pxc.x+pxc.y*width], confidence[pxc1.x+pxc.y*width]),
+                                 fminf(confidence[pxc.x+pxc1.y*width], confidence[pxc1.x+pxc1.y*width])) < minconfidence)) return;
+
         // Interpolate voxel depth
         float depth = bilinterp(y0, y1, frac);
 
@@ -83,17 +88,21 @@ void FusionUpdateP(fusionData<_bins> f, const double sigma, dim3 blocks, dim3 th
 
 template<unsigned char _bins>
 void FusionUpdateHistogram(fusionData<_bins> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                           const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads)
+                           const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                           const float * confidence, const float minconfidence)
 {
-    FusionUpdateHistogram_kernel<_bins><<<blocks, threads>>>(f, depthmap, K, R, t, threshold, width, height);
+    FusionUpdateHistogram_kernel<_bins><<<blocks, threads>>>(f, depthmap, K, R, t, threshold, width, height,
+                                                             confidence, minconfidence);
 }
 
 template<unsigned char _bins> inline
 void FusionUpdateIteration(fusionData<_bins> f, const float * depthmap, const Matrix3D K, const Matrix3D R, const Vector3D t,
                            const float threshold, const double tau, const double lambda, const double sigma,
-                           const int width, const int height, dim3 blocks, dim3 threads)
+                           const int width, const int height, dim3 blocks, dim3 threads,
+                           const float * confidence, const float minconfidence)
 {
-    FusionUpdateHistogram_kernel<_bins><<<blocks, threads>>>(f, depthmap, K, R, t, threshold, width, height);
+    FusionUpdateHistogram_kernel<_bins><<<blocks, threads>>>(f, depthmap, K, R, t, threshold, width, height,
+                                                             confidence, minconfidence);
     FusionUpdateU_kernel<_bins><<<blocks, threads>>>(f, tau, lambda);
     FusionUpdateP_kernel<_bins><<<blocks, threads>>>(f, sigma);
 }
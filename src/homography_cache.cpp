@@ -0,0 +1,48 @@
+#include "homography_cache.h"
+#include "hash.h"
+#include <helper_structs.h>
+
+const HomographyTable & HomographyCache::getTable(const Matrix3D & Rrel, const Vector3D & trel, const Matrix3D & K,
+                                                  const Matrix3D & invK, const std::vector<float> & planes)
+{
+    uint64_t key = HashBytes(&Rrel, sizeof(Matrix3D));
+    key = HashBytes(&trel, sizeof(Vector3D), key);
+    key = HashBytes(&K, sizeof(Matrix3D), key);
+    key = HashBytes(&invK, sizeof(Matrix3D), key);
+    key = HashBytes(planes.data(), planes.size() * sizeof(float), key);
+
+    counter++;
+    auto it = tables.find(key);
+    if (it != tables.end()){
+        it->second.lastused = counter;
+        return it->second.table;
+    }
+
+    // Remove least recently used table if cache is full
+    if (tables.size() >= MAX_CACHED_HOMOGRAPHY_TABLES){
+        auto lru = tables.begin();
+        for (auto t = tables.begin(); t != tables.end(); ++t)
+            if (t->second.lastused < lru->second.lastused) lru = t;
+        tables.erase(lru);
+    }
+
+    Entry & entry = tables[key];
+    entry.lastused = counter;
+    HomographyTable & table = entry.table;
+
+    // Only third column of t * n^T is nonzero
+    Matrix3D tr;
+    tr.row(2) = trel;
+    tr = tr.trans();
+
+    table.A = K * Rrel * invK;
+    table.B = K * tr * invK;
+    table.planes = planes;
+    table.H.resize(planes.size());
+    for (size_t k = 0; k < planes.size(); k++){
+        table.H[k] = table.A + table.B / planes[k];
+        table.H[k] = table.H[k] / table.H[k](2,2);
+    }
+
+    return table;
+}
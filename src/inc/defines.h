@@ -28,8 +28,66 @@
 #define DEFAULT_WINDOW_SIZE         5
 #define DEFAULT_STD_THRESHOLD       0.0001f
 #define DEFAULT_NCC_THRESHOLD       0.5f
+#define DEFAULT_PLANE_DISTRIBUTION  UniformDepth
+#define DEFAULT_SUBPLANE_REFINEMENT NoRefinement
+#define DEFAULT_CACHE_SOURCE_MAPS   false
+#define MAX_CACHED_SOURCE_MAPS      32
+#define MAX_CACHED_HOMOGRAPHY_TABLES 64
+#define DEFAULT_MATCHING_COST       ZNCCcost
+#define CENSUS_WINDOW_SIZE          5 // census bit string must fit in 32 bits
+#define DIFFERENCE_SIMILARITY_RANGE 16.f // mean absolute intensity difference of SAD and SSD with zero similarity
+#define DEFAULT_COST_VOLUME_ENCODING CostVolume8U
+#define DEFAULT_COST_VOLUME_SLAB_SIZE 16
+#define DEFAULT_GUIDED_FILTER_RADIUS 4
+#define DEFAULT_GUIDED_FILTER_EPS   6.5f // (0.01 * 255)^2
+#define BOX_FILTER_SEGMENT          8 // rows per thread in box filter column pass
+#define DEFAULT_RECTIFIED_FAST_PATH true
+#define DEFAULT_SOURCE_MIPMAPS      true
+#define MAX_MIP_LEVELS              5
+#define MIN_MIP_SIZE                16 // smallest pyramid level width and height
+#define DEFAULT_PRUNING_CANDIDATES  4 // depth candidates kept per pixel after coarse sweep
+#define DEFAULT_PRUNING_SOURCES     2 // source views swept with all planes
+#define RECTIFIED_TOLERANCE         1e-3f // largest rotation and off-axis translation error of rectified pair
+
+// Default source view selection parameters
+#define SOURCE_SELECTION_ANGLE      5.f // preferred triangulation angle in degrees
+#define SOURCE_SELECTION_SIGMA_LOW  1.f // angle score falloff below preferred angle, in degrees
+#define SOURCE_SELECTION_SIGMA_HIGH 10.f // angle score falloff above preferred angle, in degrees
+#define SOURCE_SELECTION_MIN_OVERLAP 0.3f
+#define SOURCE_SELECTION_GRID       8 // scores are sampled on grid of reference pixels
+
+// Default PatchMatch parameters
+#define DEFAULT_PATCHMATCH_ITERATIONS 8
+#define DEFAULT_PATCHMATCH_NORMALS  true
+#define PATCHMATCH_MAX_SOURCES      8
+#define PATCHMATCH_REFINE_STEPS     3
+
+// Default SGM parameters
+#define DEFAULT_SGM_P1              8
+#define DEFAULT_SGM_P2              96
+#define DEFAULT_SGM_PATHS           8
+#define SGM_MAX_P2                  7900 // sum of 8 paths must fit in 16 bits
+#define SGM_TILE_SIZE               64
+#define SGM_STRIP_MEMORY            (256 << 20) // bytes of cost and aggregated cost volume of single strip
+#define SGM_STRIP_OVERLAP           32 // rows aggregated above and below each strip and discarded
+#define SGM_MIN_STRIP_ROWS          16
 #define NO_DEPTH                    -1
 
+// Default semi-dense and epipolar search parameters
+#define DEFAULT_SEMIDENSE_GRADIENT  8.f // intensity units per pixel along epipolar line
+#define EPIPOLAR_MAX_SOURCES        8
+#define EPIPOLAR_PATCH_SIZE         5 // samples along epipolar line
+#define EPIPOLAR_MAX_STEPS          256
+#define EPIPOLAR_UNIQUENESS         0.9f // second best NCC must be below fraction of best
+
+// Default depth filter parameters
+#define DEPTH_FILTER_INIT_AB        10.f // initial Beta distribution counts
+#define DEPTH_FILTER_MIN_INLIER     0.3f // pixels with lower inlier ratio are not updated
+#define DEPTH_FILTER_CONVERGED_INLIER 0.6f
+#define DEPTH_FILTER_CONVERGED_STD  0.01f // fraction of inverse depth range
+#define DEPTH_FILTER_SEARCH_STD     2.f
+#define DEPTH_FILTER_PROCESS_NOISE  0.01f // fraction of inverse depth added on keyframe change
+
 // Default GPU parameters
 #define NO_CUDA_DEVICE              -1
 #define MAX_THREADS_PER_BLOCK       512
@@ -44,6 +102,18 @@
 #define DEFAULT_TVL1_THETA          1.f
 #define DEFAULT_TVL1_BETA           0.f
 #define DEFAULT_TVL1_GAMMA          1.f
+#define DEFAULT_TVL1_CHECK_INTERVAL 10 // iterations between convergence checks
+#define DEFAULT_TVL1_LEVELS         4
+#define DEFAULT_TVL1_COARSE_ITERATIONS 20
+#define DEFAULT_TVL1_FINE_ITERATIONS 15
+#define DEFAULT_TVL1_UPDATE_ITERATIONS 20 // iterations of warm started update
+#define TVL1_BATCH_LANES            8 // depthmaps interleaved by CpuDenoiseBatch()
+
+// Default median filter parameters
+#define DEFAULT_MEDIAN_RADIUS       2
+#define DEFAULT_MEDIAN_PASSES       1
+#define MEDIAN_FILTER_BINS          1024 // depth quantization levels
+#define MEDIAN_FILTER_COARSE        32 // coarse histogram levels, must divide MEDIAN_FILTER_BINS
 
 // Default TGV2 parameters
 #define DEFAULT_TGV_LAMBDA          0.5
@@ -63,6 +133,7 @@
 #define DEFAULT_FUSION_SIGMA        1.f
 #define DEFAULT_FUSION_IMSTEP       3
 #define DEFAULT_FUSION_ITERATIONS   50
+#define DEFAULT_FUSION_MIN_CONFIDENCE 0.05f // depths below confidence are not fused, see PlaneSweep::getConfidence()
 
 // Default fusion kernel parameters
 #define DEFAULT_FUSION_THREADS_X    16
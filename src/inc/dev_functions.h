@@ -170,6 +170,38 @@ float4 project(float4 val)
     return val / fmaxf(1.0f, length(val));
 }
 
+/**
+ *  \brief Integer hash used as stateless random number generator
+ *
+ *  \param seed value to hash
+ *  \return Hashed value
+ *
+ *  \details Thomas Wang's 32 bit integer hash, seeding with pixel index and iteration gives independent streams
+ */
+inline __host__ __device__
+unsigned int wang_hash(unsigned int seed)
+{
+    seed = (seed ^ 61) ^ (seed >> 16);
+    seed *= 9;
+    seed = seed ^ (seed >> 4);
+    seed *= 0x27d4eb2d;
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+
+/**
+ *  \brief Uniformly distributed random number in range [0,1)
+ *
+ *  \param state random number generator state, updated on each call
+ *  \return Random number
+ */
+inline __host__ __device__
+float random_uniform(unsigned int & state)
+{
+    state = wang_hash(state);
+    return state * (1.f / 4294967296.f);
+}
+
 /** @} */ // group general
 
 #endif // DEVICE_FUNCTIONS_H
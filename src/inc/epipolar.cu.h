@@ -0,0 +1,144 @@
+/**
+ *  \file epipolar.cu.h
+ *  \brief Header file containing epipolar line search kernel invocation functions
+ */
+#ifndef EPIPOLAR_CU_H
+#define EPIPOLAR_CU_H
+
+#include <helper_cuda.h>
+#include <cuda_runtime_api.h>
+#include <cuda.h>
+#include <structs.h>
+#include "defines.h"
+
+/** \addtogroup epipolar  Epipolar search
+* \brief Per pixel depth search along epipolar lines running on GPU
+*
+* \details Reference pixel \f$p\f$ at inverse depth \f$q\f$ projects to \f$A p + q b\f$ in source view, where
+* \f$A = K R_{rel} K^{-1}\f$ and \f$b = K t_{rel}\f$. Inverse depth range is sampled so that adjacent samples are about
+* one pixel apart in the source view with the longest epipolar segment. At each sample \a EPIPOLAR_PATCH_SIZE
+* reference values along the reference epipolar line are compared to their projections in all source views by NCC.
+* @{
+*/
+
+/**
+ *  \brief Cameras and source views used by epipolar search
+ */
+struct EpipolarParams
+{
+    Matrix3D A[EPIPOLAR_MAX_SOURCES];           ///< \f$K R_{rel} K^{-1}\f$ for each source view
+    float3 b[EPIPOLAR_MAX_SOURCES];             ///< \f$K t_{rel}\f$ for each source view
+    const float * src[EPIPOLAR_MAX_SOURCES];    ///< pointers to source views on the device
+    int nsrc;                                   ///< number of source views
+    float3 epipole;                             ///< homogeneous epipole of first source view in reference view
+    float stdthresh;                            ///< patches with STD below threshold are not matched
+    float nccthresh;                            ///< matches with NCC below threshold are rejected
+};
+
+/**
+ *  \brief Semi-dense depth estimation for high gradient pixels
+ *
+ *  \param d_depth      pointer to output depthmap, 0 where no depth was found
+ *  \param d_ncc        pointer to output NCC of found depth
+ *  \param d_mask       pointer to output mask, 1 where depth was found and 0 otherwise
+ *  \param d_ref        pointer to reference image
+ *  \param params       cameras and source views
+ *  \param gradthresh   pixels with intensity gradient along epipolar line below threshold are skipped
+ *  \param znear        near plane depth
+ *  \param zfar         far plane depth
+ *  \param width        width of given arrays
+ *  \param height       height of given arrays
+ *  \param blocks       kernel grid dimensions
+ *  \param threads      single block dimensions
+ *
+ *  \details Matches which are not unique along epipolar line are rejected
+ */
+void semidense_depth(float * d_depth, float * d_ncc, unsigned char * d_mask, const float * d_ref,
+                     const EpipolarParams & params, const float gradthresh, const float znear, const float zfar,
+                     const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Initialize depth filter state
+ *
+ *  \param d_state  pointer to per pixel state (inverse depth mean, inverse depth variance, inlier and outlier
+ *                  counts of Beta distribution)
+ *  \param qmin     smallest inverse depth
+ *  \param qmax     largest inverse depth
+ *  \param width    width of given array
+ *  \param height   height of given array
+ *  \param blocks   kernel grid dimensions
+ *  \param threads  single block dimensions
+ *
+ *  \details Inverse depth is centered in range with standard deviation of one sixth of range
+ */
+void depth_filter_init(float4 * d_state, const float qmin, const float qmax,
+                       const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Propagate depth filter state to new keyframe
+ *
+ *  \param d_state_new pointer to new keyframe state, has to be initialized with \a depth_filter_init()
+ *  \param d_nearest   pointer to temporary array, has to be set to 0
+ *  \param d_state     pointer to old keyframe state
+ *  \param A           \f$K R_{rel} K^{-1}\f$ from old to new keyframe
+ *  \param b           \f$K t_{rel}\f$ from old to new keyframe
+ *  \param width       width of given arrays
+ *  \param height      height of given arrays
+ *  \param blocks      kernel grid dimensions
+ *  \param threads     single block dimensions
+ *
+ *  \details Each pixel is moved to nearest new keyframe pixel, nearest depth wins when several pixels collide.
+ * Variance is scaled with inverse depth and increased by \a DEPTH_FILTER_PROCESS_NOISE.
+ */
+void depth_filter_propagate(float4 * d_state_new, float * d_nearest, const float4 * d_state,
+                            const Matrix3D & A, const float3 & b,
+                            const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Collect active depth filter pixels
+ *
+ *  \param d_active pointer to output list of active pixel indexes, of at least \a width * \a height elements
+ *  \param d_count  pointer to number of active pixels, has to be set to 0
+ *  \param d_state  pointer to per pixel state
+ *  \param qmin     smallest inverse depth
+ *  \param qmax     largest inverse depth
+ *  \param width    width of given arrays
+ *  \param height   height of given arrays
+ *  \param blocks   kernel grid dimensions
+ *  \param threads  single block dimensions
+ *
+ *  \details Pixel is active if it is neither converged nor diverged and is not on image border
+ */
+void depth_filter_active(int * d_active, unsigned int * d_count, const float4 * d_state,
+                         const float qmin, const float qmax,
+                         const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Update active depth filter pixels with new frame
+ *
+ *  \param d_state     pointer to per pixel state
+ *  \param d_ref       pointer to keyframe image
+ *  \param params      camera of single new frame
+ *  \param gradthresh  pixels with intensity gradient along epipolar line below threshold are skipped
+ *  \param qmin        smallest inverse depth
+ *  \param qmax        largest inverse depth
+ *  \param d_active    pointer to list of active pixel indexes, see \a depth_filter_active()
+ *  \param nactive     number of active pixels
+ *  \param d_next      pointer to output list of pixels still active after update
+ *  \param d_nnext     pointer to number of pixels still active, has to be set to 0
+ *  \param width       width of given arrays
+ *  \param height      height of given arrays
+ *  \param threads     single block dimensions, active pixels are processed with 1D blocks of the same number of threads
+ *
+ *  \details Only listed pixels are searched, within \a DEPTH_FILTER_SEARCH_STD standard deviations of their inverse
+ * depth. Match is fused with Gaussian x Uniform model, failed search counts as outlier. Pixels which converge or
+ * diverge are dropped from \p d_next, so cost of update depends on number of active pixels only.
+ */
+void depth_filter_update(float4 * d_state, const float * d_ref, const EpipolarParams & params,
+                         const float gradthresh, const float qmin, const float qmax,
+                         const int * d_active, const unsigned int nactive, int * d_next, unsigned int * d_nnext,
+                         const int width, const int height, dim3 threads);
+
+/** @} */ // group epipolar
+
+#endif // EPIPOLAR_CU_H
@@ -9,6 +9,7 @@
 #include <cuda_runtime_api.h>
 #include <cuda.h>
 #include "fusion.h"
+#include "defines.h"
 
 /** \addtogroup fusion  Depthmap fusion
 * \brief Depthmap fusion functions running on GPU
@@ -33,13 +34,17 @@
  *  \param height       height of depthmap
  *  \param blocks       kernel grid dimensions
  *  \param threads      single block dimensions
+ *  \param confidence   pointer to per pixel depth confidence, see \a PlaneSweep::getConfidence(), 0 if not used
+ *  \param minconfidence depths interpolated from pixels with lower confidence are skipped
  *  \return No return value
  *
  *  \details Signed distance is clamped to [-threshold,threshold] and divided by \a threshold before updating any histogram bins.
+ * Histogram bins hold integer votes, so low confidence depths are skipped instead of down-weighted.
  */
 template<unsigned char _bins>
 void FusionUpdateHistogram(fusionData<_bins> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                           const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                           const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                           const float * confidence = 0, const float minconfidence = DEFAULT_FUSION_MIN_CONFIDENCE);
 
 /**
  *  \brief Update primal variable \f$u\f$ and helper variable \f$v\f$ using histogram depthmap fusion algorithm
@@ -86,52 +91,65 @@ void FusionUpdateP(fusionData<_bins> f, const double sigma, dim3 blocks, dim3 th
  *  \param height       height of depthmap
  *  \param blocks       kernel grid dimensions
  *  \param threads      single block dimensions
+ *  \param confidence   pointer to per pixel depth confidence, see \a PlaneSweep::getConfidence(), 0 if not used
+ *  \param minconfidence depths interpolated from pixels with lower confidence are skipped
  *  \return No return value
  *
  *  \details Signed distance is clamped to [-threshold,threshold] and divided by \a threshold before updating any histogram bins.
+ * Histogram bins hold integer votes, so low confidence depths are skipped instead of down-weighted.
  */
 template<unsigned char _bins>
 void FusionUpdateIteration(fusionData<_bins, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                            const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                           const int width, const int height, dim3 blocks, dim3 threads);
+                           const int width, const int height, dim3 blocks, dim3 threads,
+                           const float * confidence = 0, const float minconfidence = DEFAULT_FUSION_MIN_CONFIDENCE);
 
 // Explicit template instantiations
 template void
 FusionUpdateIteration<2>(fusionData<2, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<3>(fusionData<3, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<4>(fusionData<4, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<5>(fusionData<5, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<6>(fusionData<6, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<7>(fusionData<7, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<8>(fusionData<8, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<9>(fusionData<9, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                          const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                         const int width, const int height, dim3 blocks, dim3 threads);
+                         const int width, const int height, dim3 blocks, dim3 threads,
+                         const float * confidence, const float minconfidence);
 template void
 FusionUpdateIteration<10>(fusionData<10, Device> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
                           const Vector3D t, const float threshold, const double tau, const double lambda, const double sigma,
-                          const int width, const int height, dim3 blocks, dim3 threads);
+                          const int width, const int height, dim3 blocks, dim3 threads,
+                          const float * confidence, const float minconfidence);
 
 template void FusionUpdateP<2>(fusionData<2> f, const double sigma, dim3 blocks, dim3 threads);
 template void FusionUpdateP<3>(fusionData<3> f, const double sigma, dim3 blocks, dim3 threads);
@@ -154,23 +172,32 @@ template void FusionUpdateU<9>(fusionData<9> f, const double tau, const double l
 template void FusionUpdateU<10>(fusionData<10> f, const double tau, const double lambda, dim3 blocks, dim3 threads);
 
 template void FusionUpdateHistogram<2>(fusionData<2> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                      const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                      const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                      const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<3>(fusionData<3> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                       const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<4>(fusionData<4> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                       const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<5>(fusionData<5> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                       const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<6>(fusionData<6> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                       const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<7>(fusionData<7> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                       const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<8>(fusionData<8> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                       const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<9>(fusionData<9> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                       const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                       const float * confidence, const float minconfidence);
 template void FusionUpdateHistogram<10>(fusionData<10> f, const float * depthmap, const Matrix3D K, const Matrix3D R,
-                                        const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads);
+                                        const Vector3D t, const float threshold, const int width, const int height, dim3 blocks, dim3 threads,
+                                        const float * confidence, const float minconfidence);
 /** @} */ // group fusion
 
 #endif // FUSION_CU_H
@@ -0,0 +1,89 @@
+/**
+ *  \file guided_filter.h
+ *  \brief Header file containing guided filter used for planesweep cost slice aggregation
+ */
+#ifndef GUIDED_FILTER_H
+#define GUIDED_FILTER_H
+
+#include "defines.h"
+#include "image.h"
+#include <kernels.cu.h>
+
+/** \addtogroup planesweep
+* @{
+*/
+
+/**
+*  \brief Guided filter with reference image as guide
+*
+*  \details Guide statistics are calculated once by \a prepareGuide() and reused for every filtered slice. All box
+* filters use running sums, so filtering cost does not depend on filter radius.
+*/
+struct GuidedFilter
+{
+    Image<float> meanI;     ///< box filtered guide
+    Image<float> varI;      ///< windowed variance of guide
+    int radius = DEFAULT_GUIDED_FILTER_RADIUS;
+    float eps = DEFAULT_GUIDED_FILTER_EPS;
+
+    /**
+    *  \brief Calculate guide statistics
+    *
+    *  \param I       pointer to guide image on the device
+    *  \param radius  filter radius
+    *  \param eps     regularization parameter \f$\epsilon\f$
+    *  \param w       image width
+    *  \param h       image height
+    *  \param blocks  kernel grid dimensions
+    *  \param threads single block dimensions
+    */
+    void prepareGuide(const float * I, const int radius, const float eps,
+                      const int w, const int h, dim3 blocks, dim3 threads)
+    {
+        this->radius = radius;
+        this->eps = eps;
+        meanI.reset(w, h);
+        varI.reset(w, h);
+        Image<float> tmp1(w, h), tmp2(w, h);
+        box_filter(meanI.data(), tmp1.data(), I, radius, w, h, threads);
+        element_multiply(tmp2.data(), I, I, w, h, blocks, threads);
+        box_filter(varI.data(), tmp1.data(), tmp2.data(), radius, w, h, threads);
+        calculate_STD(tmp2.data(), meanI.data(), varI.data(), w, h, blocks, threads);
+        element_multiply(varI.data(), tmp2.data(), tmp2.data(), w, h, blocks, threads);
+    }
+
+    /**
+    *  \brief Filter single cost slice in place
+    *
+    *  \param p       pointer to slice to be filtered
+    *  \param I       pointer to guide image
+    *  \param tmp1    pointer to intermediate image
+    *  \param tmp2    pointer to intermediate image
+    *  \param tmp3    pointer to intermediate image
+    *  \param tmp4    pointer to intermediate image
+    *  \param w       image width
+    *  \param h       image height
+    *  \param blocks  kernel grid dimensions
+    *  \param threads single block dimensions
+    */
+    void filter(float * p, const float * I, float * tmp1, float * tmp2, float * tmp3, float * tmp4,
+                const int w, const int h, dim3 blocks, dim3 threads)
+    {
+        // tmp1 - mean of p, tmp2 - mean of I * p
+        box_filter(tmp1, tmp4, p, radius, w, h, threads);
+        element_multiply(tmp3, I, p, w, h, blocks, threads);
+        box_filter(tmp2, tmp4, tmp3, radius, w, h, threads);
+
+        // tmp3 - a, p - b
+        guided_filter_coefficients(tmp3, p, tmp1, tmp2, meanI.data(), varI.data(), eps, w, h, blocks, threads);
+
+        // q = mean of a * I + mean of b
+        box_filter(tmp1, tmp4, tmp3, radius, w, h, threads);
+        box_filter(tmp2, tmp4, p, radius, w, h, threads);
+        guided_filter_output(p, tmp1, tmp2, I, w, h, blocks, threads);
+    }
+};
+
+/** @} */ // group planesweep
+
+#endif // GUIDED_FILTER_H
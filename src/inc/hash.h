@@ -0,0 +1,31 @@
+/**
+ *  \file hash.h
+ *  \brief Header file containing hashing function used for cache keys
+ */
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ *  \brief 64 bit FNV-1a hash of given data
+ *
+ *  \param data pointer to data
+ *  \param size data size in bytes
+ *  \param seed hash of preceding data
+ *  \return Hash value
+ *
+ *  \details Hashes of consecutive blocks of data are combined by passing previous hash as \p seed
+ */
+inline uint64_t HashBytes(const void * data, size_t size, uint64_t seed = 14695981039346656037ULL)
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++){
+        seed ^= bytes[i];
+        seed *= 1099511628211ULL;
+    }
+    return seed;
+}
+
+#endif // HASH_H
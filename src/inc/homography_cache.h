@@ -0,0 +1,84 @@
+/**
+ *  \file homography_cache.h
+ *  \brief Header file containing HomographyCache class implementation
+ */
+#ifndef HOMOGRAPHY_CACHE_H
+#define HOMOGRAPHY_CACHE_H
+
+#include "defines.h"
+#include "structs.h"
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+/** \addtogroup planesweep
+* @{
+*/
+
+/**
+*  \brief Plane induced homographies between reference and single source view
+*
+*  \details Homography of plane at depth \f$d\f$ is given by \f$H = A + B/d\f$, where \f$A = K R_{rel} K^{-1}\f$ and
+* \f$B = K t_{rel} n^T K^{-1}\f$ with \f$n = (0,0,1)^T\f$. Homographies in \a H are normalized so that \f$H_{33} = 1\f$.
+*/
+struct HomographyTable
+{
+    Matrix3D A;                 ///< rotational part of homographies
+    Matrix3D B;                 ///< translational part of homographies scaled by inverse depth
+    std::vector<float> planes;  ///< plane depths
+    std::vector<Matrix3D> H;    ///< normalized homography for each plane
+};
+
+/**
+*  \brief Class that caches plane induced homography tables per reference-source pair
+*
+*  \details Tables are keyed by relative rotation and translation, camera matrix and plane depths, so changing pose,
+* camera matrix or planes creates a new table. Least recently used table is removed when cache holds
+* \a MAX_CACHED_HOMOGRAPHY_TABLES tables. Used by every plane based sweep: planesweep, cost volume and pruned
+* planesweep. \a PlaneSweep::RunRectified() does not use it, because rectified pairs are searched by integer
+* disparity shifts along image rows and no homographies are calculated.
+*/
+class HomographyCache
+{
+public:
+    /**
+    *  \brief Get homography table, calculating it if it is not cached
+    *
+    *  \param Rrel   relative rotation from reference to source view
+    *  \param trel   relative translation from reference to source view
+    *  \param K      camera calibration matrix
+    *  \param invK   inverse of camera calibration matrix
+    *  \param planes plane depths
+    *  \return Homography table, valid until next call to \a getTable() or \a clear()
+    */
+    const HomographyTable & getTable(const Matrix3D & Rrel, const Vector3D & trel, const Matrix3D & K,
+                                     const Matrix3D & invK, const std::vector<float> & planes);
+
+    /**
+    *  \brief Remove all cached tables
+    */
+    void clear(){ tables.clear(); }
+
+    /**
+    *  \brief Get number of cached tables
+    *
+    *  \return Number of cached tables
+    */
+    size_t size() const { return tables.size(); }
+
+protected:
+
+    /** \brief Cached table with its use counter */
+    struct Entry
+    {
+        uint64_t lastused;
+        HomographyTable table;
+    };
+
+    std::map<uint64_t, Entry> tables;
+    uint64_t counter = 0;
+};
+
+/** @} */ // group planesweep
+
+#endif // HOMOGRAPHY_CACHE_H
@@ -12,6 +12,7 @@
 #include <cuda_runtime_api.h>
 #include <cuda.h>
 #include <structs.h>
+#include "defines.h"
 
 /** \addtogroup general  General
 * \brief General CUDA kernel functions, mostly for float type data
@@ -311,6 +312,59 @@ void update_arrays(float * d_depthmap, float * d_bestncc,
                    const int width, const int height,
                    dim3 blocks, dim3 threads);
 
+/**
+*  \brief Depthmap update function which also keeps NCC values of neighbouring planes for sub-plane refinement
+*
+*  \param d_depthmap      pointer to depthmap to be updated
+*  \param d_bestncc       pointer to best NCC values to be updated
+*  \param d_bestindex     pointer to plane indexes of best NCC values to be updated
+*  \param d_prevncc       pointer to NCC values of previous plane, replaced by current NCC values
+*  \param d_nccbelow      pointer to NCC values of plane preceding best plane
+*  \param d_nccabove      pointer to NCC values of plane following best plane
+*  \param d_currentncc    pointer to input NCC values calculated at \a current_depth
+*  \param current_depth   current depth of planesweep algorithm
+*  \param current_index   current plane index of planesweep algorithm
+*  \param width           width of given arrays
+*  \param height          height of given arrays
+*  \param blocks          kernel grid dimensions
+*  \param threads         single block dimensions
+*
+*  \details Planes must be swept in order of increasing index. \a d_bestindex should be initialized to -1.
+*/
+void update_arrays_subplane(float * d_depthmap, float * d_bestncc,
+                            float * d_bestindex, float * d_prevncc,
+                            float * d_nccbelow, float * d_nccabove,
+                            const float * d_currentncc, const float current_depth,
+                            const int current_index,
+                            const int width, const int height,
+                            dim3 blocks, dim3 threads);
+
+/**
+*  \brief Refine depthmap between discrete planes by fitting NCC values of best and neighbouring planes
+*
+*  \param d_depthmap      pointer to depthmap to be refined
+*  \param d_bestncc       pointer to best NCC values
+*  \param d_bestindex     pointer to plane indexes of best NCC values
+*  \param d_nccbelow      pointer to NCC values of plane preceding best plane
+*  \param d_nccabove      pointer to NCC values of plane following best plane
+*  \param d_planes        pointer to plane depths
+*  \param nplanes         number of planes
+*  \param equiangular     equiangular line fit is used if true, parabola fit otherwise
+*  \param width           width of given arrays
+*  \param height          height of given arrays
+*  \param blocks          kernel grid dimensions
+*  \param threads         single block dimensions
+*
+*  \details Peak offset is clamped to half a plane and depth is interpolated linearly between neighbouring planes
+*/
+void refine_depth_subplane(float * d_depthmap, const float * d_bestncc,
+                           const float * d_bestindex,
+                           const float * d_nccbelow, const float * d_nccabove,
+                           const float * d_planes, const int nplanes,
+                           const bool equiangular,
+                           const int width, const int height,
+                           dim3 blocks, dim3 threads);
+
 /**
 *  \brief Sum depthmaps and increases summation count if corresponding NCC value is greater than threshold
 *
@@ -332,6 +386,285 @@ void sum_depthmap_NCC(float * d_depthmap_out, float * d_count,
                       const int width, const int height,
                       dim3 blocks, dim3 threads);
 
+/**
+*  \brief Update NCC peak statistics with similarity of current plane
+*
+*  \param d_peak         pointer to peak statistics: best NCC, best NCC at least two planes away from best plane,
+*                        NCC sum and best plane index; initialized when \p current_index is 0
+*  \param d_currentncc   pointer to NCC of current plane
+*  \param current_index  index of current plane, planes must be swept in order
+*  \param width          width of given arrays
+*  \param height         height of given arrays
+*  \param blocks         kernel grid dimensions
+*  \param threads        single block dimensions
+*
+*  \details Second best NCC is tracked online, so it is approximate when best plane moves by one plane.
+*/
+void update_peak(float4 * d_peak, const float * d_currentncc, const int current_index,
+                 const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+*  \brief Sum depth confidence where corresponding NCC value is greater than threshold
+*
+*  \param d_confidence_out pointer to summed confidence to be updated
+*  \param d_peak           pointer to peak statistics from \a update_peak()
+*  \param d_ncc            pointer to NCC values of depthmap
+*  \param nccthreshold     NCC threshold
+*  \param nplanes          number of planes
+*  \param width            width of given arrays
+*  \param height           height of given arrays
+*  \param blocks           kernel grid dimensions
+*  \param threads          single block dimensions
+*
+*  \details Confidence is product of second best ratio \f$1 - \max(c_2, 0) / c_1\f$ and peak sharpness
+* \f$c_1 - \bar{c}\f$ clamped to [0,1], where \f$c_1\f$ is best NCC, \f$c_2\f$ second best and \f$\bar{c}\f$ mean NCC
+* over planes. Same pixels as in \a sum_depthmap_NCC() are summed, so dividing by its count gives average confidence.
+*/
+void sum_confidence(float * d_confidence_out, const float4 * d_peak, const float * d_ncc,
+                    const float nccthreshold, const int nplanes,
+                    const int width, const int height,
+                    dim3 blocks, dim3 threads);
+
+/**
+*  \brief Element-wise difference of two arrays
+*
+*  \param d_output    pointer to output data
+*  \param d_input1    pointer to minuend data
+*  \param d_input2    pointer to subtrahend data
+*  \param absolute    absolute value of difference is stored if true
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*
+*  \details Used by SAD and SSD matching costs, squaring is done by windowed mean functions
+*/
+void element_difference(float * d_output, const float * d_input1,
+                        const float * d_input2, const bool absolute,
+                        const int width, const int height,
+                        dim3 blocks, dim3 threads);
+
+/**
+*  \brief Census transform of an image
+*
+*  \param d_output    pointer to output census bit strings
+*  \param d_input     pointer to input image
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*
+*  \details Each bit is set if corresponding neighbour in \a CENSUS_WINDOW_SIZE window is darker than center pixel
+*/
+void census_transform(unsigned int * d_output, const float * d_input,
+                      const int width, const int height,
+                      dim3 blocks, dim3 threads);
+
+/**
+*  \brief Hamming distance between census bit strings
+*
+*  \param d_output    pointer to output distances
+*  \param d_input1    pointer to first census bit strings
+*  \param d_input2    pointer to second census bit strings
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*/
+void hamming_distance(float * d_output, const unsigned int * d_input1,
+                      const unsigned int * d_input2,
+                      const int width, const int height,
+                      dim3 blocks, dim3 threads);
+
+/**
+*  \brief Convert matching cost to similarity compatible with NCC threshold
+*
+*  \param d_output    pointer to output similarity
+*  \param d_cost      pointer to input cost
+*  \param scale       inverse of cost with zero similarity
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*
+*  \details Similarity is given by \f$\max(1 - scale \cdot cost, -1)\f$, so it has the range of NCC
+*/
+void cost_to_similarity(float * d_output, const float * d_cost,
+                        const float scale, const int width, const int height,
+                        dim3 blocks, dim3 threads);
+
+/**
+*  \brief Add input array to output array element-wise
+*
+*  \param d_output    pointer to data to add to
+*  \param d_input     pointer to data to be added
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*/
+void element_accumulate(float * d_output, const float * d_input,
+                        const int width, const int height,
+                        dim3 blocks, dim3 threads);
+
+/**
+*  \brief Encode cost volume slice as 8 bit values
+*
+*  \param d_output     pointer to encoded cost slice
+*  \param d_similarity pointer to summed similarity of all source views
+*  \param scale        inverse of number of source views
+*  \param width        width of given arrays
+*  \param height       height of given arrays
+*  \param blocks       kernel grid dimensions
+*  \param threads      single block dimensions
+*
+*  \details Cost \f$1 - scale \cdot similarity\f$ in range [0,2] is mapped to [0,255], QNAN is mapped to 255
+*/
+void encode_cost_uchar(unsigned char * d_output, const float * d_similarity,
+                       const float scale, const int width, const int height,
+                       dim3 blocks, dim3 threads);
+
+/**
+*  \brief Encode cost volume slice as half precision floats
+*
+*  \param d_output     pointer to encoded cost slice, bit patterns of \a half values
+*  \param d_similarity pointer to summed similarity of all source views
+*  \param scale        inverse of number of source views
+*  \param width        width of given arrays
+*  \param height       height of given arrays
+*  \param blocks       kernel grid dimensions
+*  \param threads      single block dimensions
+*
+*  \details Cost is given by \f$1 - scale \cdot similarity\f$
+*/
+void encode_cost_half(unsigned short * d_output, const float * d_similarity,
+                      const float scale, const int width, const int height,
+                      dim3 blocks, dim3 threads);
+
+/**
+*  \brief Box filter with running sums, complexity per pixel does not depend on \a radius
+*
+*  \param d_output    pointer to filtered data
+*  \param d_temp      pointer to intermediate data
+*  \param d_input     pointer to input data
+*  \param radius      filter radius, window size is \f$2 \cdot radius + 1\f$
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param threads     block dimensions
+*
+*  \details Window is clipped at image borders and mean is taken over pixels inside the image. Window sum of each
+* pixel differs from the previous one by pixel entering and pixel leaving the window, so sums are scans of these
+* changes. Row pass scans \p threads.x consecutive pixels of each row in shared memory and carries the sum along the
+* row, column pass scans segments of \a BOX_FILTER_SEGMENT rows starting from sums carried over segment totals.
+* Both passes read and write global memory coalesced, only the window sum of the first pixel of each row and column
+* is summed over \p radius pixels.
+*/
+void box_filter(float * d_output, float * d_temp, const float * d_input,
+                const int radius, const int width, const int height,
+                dim3 threads);
+
+/**
+*  \brief Guided filter linear coefficients
+*
+*  \param d_a         pointer to output coefficients \f$a\f$
+*  \param d_b         pointer to output coefficients \f$b\f$
+*  \param d_mean_p    pointer to box filtered input
+*  \param d_corr_Ip   pointer to box filtered product of guide and input
+*  \param d_mean_I    pointer to box filtered guide
+*  \param d_var_I     pointer to windowed variance of guide
+*  \param eps         regularization parameter \f$\epsilon\f$
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*
+*  \details \f$a = (corr_{Ip} - \mu_I \mu_p) / (\sigma_I^2 + \epsilon)\f$, \f$b = \mu_p - a \mu_I\f$
+*/
+void guided_filter_coefficients(float * d_a, float * d_b,
+                                const float * d_mean_p, const float * d_corr_Ip,
+                                const float * d_mean_I, const float * d_var_I,
+                                const float eps, const int width, const int height,
+                                dim3 blocks, dim3 threads);
+
+/**
+*  \brief Guided filter output
+*
+*  \param d_output    pointer to filtered data
+*  \param d_mean_a    pointer to box filtered coefficients \f$a\f$
+*  \param d_mean_b    pointer to box filtered coefficients \f$b\f$
+*  \param d_I         pointer to guide image
+*  \param width       width of given arrays
+*  \param height      height of given arrays
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*/
+void guided_filter_output(float * d_output, const float * d_mean_a,
+                          const float * d_mean_b, const float * d_I,
+                          const int width, const int height,
+                          dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Pointers to levels of image pyramid on the device
+ */
+struct MipLevels
+{
+    const float * level[MAX_MIP_LEVELS];    ///< level 0 is full resolution, each next level has half the size
+    int width[MAX_MIP_LEVELS];              ///< level widths
+    int height[MAX_MIP_LEVELS];             ///< level heights
+    int levels;                             ///< number of valid levels
+};
+
+/**
+*  \brief Downsample data by factor of 2 with 2 x 2 box filter
+*
+*  \param d_output    pointer to output data
+*  \param d_input     pointer to input data
+*  \param inwidth     input width
+*  \param inheight    input height
+*  \param width       output width, half of input width
+*  \param height      output height, half of input height
+*  \param blocks      kernel grid dimensions covering output
+*  \param threads     single block dimensions
+*/
+void downsample(float * d_output, const float * d_input, const int inwidth, const int inheight,
+                const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+*  \brief Upsample data with bilinear interpolation
+*
+*  \param d_output    pointer to output data
+*  \param d_input     pointer to input data
+*  \param inwidth     input width
+*  \param inheight    input height
+*  \param width       output width
+*  \param height      output height
+*  \param blocks      kernel grid dimensions covering output
+*  \param threads     single block dimensions
+*
+*  \details Pixel centers of input and output grids are aligned, values outside of input are clamped to border.
+*/
+void upsample(float * d_output, const float * d_input, const int inwidth, const int inheight,
+              const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+*  \brief Warp source pyramid by homography, sampling level matched to local scale
+*
+*  \param d_result    pointer to warped output data
+*  \param src         source pyramid levels
+*  \param h           homography from reference to source pixel coordinates
+*  \param width       output width
+*  \param height      output height
+*  \param blocks      kernel grid dimensions
+*  \param threads     single block dimensions
+*
+*  \details Level is chosen per block from the longest source footprint of one reference pixel at block
+* center, \f$\lfloor \log_2 s \rfloor\f$, so minified warps read smaller, prefiltered images. Level 0 is used
+* when homography does not minify, giving the same result as \a transform_indexes() followed by
+* \a bilinear_interpolation(). Samples outside of source are set to 0.
+*/
+void warp_mipmapped(float * d_result, const MipLevels & src, const Matrix3D h,
+                    const int width, const int height, dim3 blocks, dim3 threads);
+
 /** @} */ // group planesweep
 
 /** \addtogroup TVL1  TVL1 denoising
@@ -372,6 +705,32 @@ void denoising_TVL1_update(float * d_output, float * d_R,
                            const float tau, const float theta, const float lambda, const float sigma,
                            const int width, const int height, dim3 blocks, dim3 threads);
 
+/**
+ *  \brief Update dual variable \f$r\f$ and primal variable \f$u\f$ values and sum their change
+ *
+ *  \param d_output pointer to primal variable \f$u\f$ values to be updated
+ *  \param d_R      pointer to dual variable \f$r\f$ values to be updated
+ *  \param d_Px     pointer to input component \a x of dual variable \f$p\f$
+ *  \param d_Py     pointer to input component \a y of dual variable \f$p\f$
+ *  \param d_origin pointer to input original input image normalized and scaled by \f$-\sigma\f$
+ *  \param d_change pointer to two values, \f$\sum (u^{n+1} - u^n)^2\f$ and \f$\sum (u^{n+1})^2\f$ are added to them
+ *  \param tau      TVL1 parameter \f$\tau\f$
+ *  \param theta    TVL1 parameter \f$\theta\f$
+ *  \param lambda   TVL1 parameter \f$\lambda\f$
+ *  \param sigma    TVL1 parameter \f$\sigma\f$
+ *  \param width    width of given arrays
+ *  \param height   height of given arrays
+ *  \param blocks   kernel grid dimensions
+ *  \param threads  single block dimensions
+ *
+ *  \details Same update as \a denoising_TVL1_update() with block reduction of the change fused in, so checking
+ * convergence costs no extra pass over the image. \p d_change must be zeroed before the call.
+ */
+void denoising_TVL1_update_change(float * d_output, float * d_R,
+                                  const float * d_Px, const float * d_Py, const float * d_origin, float * d_change,
+                                  const float tau, const float theta, const float lambda, const float sigma,
+                                  const int width, const int height, dim3 blocks, dim3 threads);
+
 /**
  *  \brief Update dual variable \f$r\f$ and primal variable \f$u\f$ values by weighing with 2 by 2 tensor \f$T\f$
  *
@@ -0,0 +1,155 @@
+/**
+ *  \file matching_cost.h
+ *  \brief Header file containing matching cost policies used by planesweep
+ *
+ *  Every policy converts its cost to similarity in range \f$[-1,1]\f$ where greater value means better match, so
+ *  that best plane selection and NCC threshold are shared by all policies. As with NCC, unrelated windows have
+ *  similarity around 0 and identical windows have similarity 1.
+ */
+#ifndef MATCHING_COST_H
+#define MATCHING_COST_H
+
+#include "defines.h"
+#include "image.h"
+#include <kernels.cu.h>
+
+/** \addtogroup planesweep
+* @{
+*/
+
+/**
+*  \brief Zero mean normalized cross correlation matching cost
+*/
+struct ZNCCPolicy
+{
+    Image<float> refmean;   ///< reference windowed means
+    Image<float> refstd;    ///< reference windowed STD
+
+    /**
+    *  \brief Calculate reference image data used by \a similarity()
+    *
+    *  \param ref       pointer to reference image on the device
+    *  \param winsize   matching window size
+    *  \param stdthresh windows with STD below threshold have zero similarity
+    *  \param w         image width
+    *  \param h         image height
+    *  \param blocks    kernel grid dimensions
+    *  \param threads   single block dimensions
+    */
+    void prepareReference(const float * ref, const unsigned int winsize, const float stdthresh,
+                          const int w, const int h, dim3 blocks, dim3 threads)
+    {
+        this->stdthresh = stdthresh;
+        refmean.reset(w, h);
+        refstd.reset(w, h);
+        Image<float> inter(w, h); // will hold square of means in this computation
+        windowed_mean_column(inter.data(), ref, winsize, false, w, h, blocks, threads);
+        windowed_mean_row(refmean.data(), inter.data(), winsize, false, w, h, blocks, threads);
+        windowed_mean_column(inter.data(), ref, winsize, true, w, h, blocks, threads);
+        windowed_mean_row(refstd.data(), inter.data(), winsize, false, w, h, blocks, threads);
+        calculate_STD(refstd.data(), refmean.data(), refstd.data(), w, h, blocks, threads);
+    }
+
+    /**
+    *  \brief Calculate similarity of reference and warped source image
+    *
+    *  \param out       pointer to output similarity
+    *  \param ref       pointer to reference image
+    *  \param warped    pointer to warped source image, overwritten
+    *  \param tmp1      pointer to intermediate image
+    *  \param tmp2      pointer to intermediate image
+    *  \param tmp3      pointer to intermediate image
+    *  \param winsize   matching window size
+    *  \param w         image width
+    *  \param h         image height
+    *  \param blocks    kernel grid dimensions
+    *  \param threads   single block dimensions
+    */
+    void similarity(float * out, const float * ref, float * warped, float * tmp1, float * tmp2, float * tmp3,
+                    const unsigned int winsize, const int w, const int h, dim3 blocks, dim3 threads)
+    {
+        // tmp1 - will hold windowed mean of warped image
+        // tmp2 - will hold windowed std of warped image
+        windowed_mean_column(tmp3, warped, winsize, false, w, h, blocks, threads);
+        windowed_mean_row(tmp1, tmp3, winsize, false, w, h, blocks, threads);
+
+        windowed_mean_column(tmp2, warped, winsize, true, w, h, blocks, threads);
+        windowed_mean_row(tmp3, tmp2, winsize, false, w, h, blocks, threads);
+
+        calculate_STD(tmp2, tmp1, tmp3, w, h, blocks, threads);
+
+        // NCC = (mean of products - product of means) / product of standard deviations
+        element_multiply(tmp3, ref, warped, w, h, blocks, threads);
+        windowed_mean_column(warped, tmp3, winsize, false, w, h, blocks, threads);
+        windowed_mean_row(tmp3, warped, winsize, false, w, h, blocks, threads);
+        calcNCC(out, tmp3, refmean.data(), tmp1, refstd.data(), tmp2, stdthresh, stdthresh, w, h, blocks, threads);
+    }
+
+    float stdthresh = DEFAULT_STD_THRESHOLD;
+};
+
+/**
+*  \brief Sum of absolute differences (\a absolute = true) or sum of squared differences matching cost
+*
+*  \details Mean absolute difference of \a DIFFERENCE_SIMILARITY_RANGE, or its square for squared differences, has
+* zero similarity, larger differences are clamped to -1.
+*/
+template<bool absolute>
+struct DifferencePolicy
+{
+    /** \brief No reference data is needed */
+    void prepareReference(const float *, const unsigned int, const float, const int, const int, dim3, dim3) {}
+
+    /** \brief Calculate similarity of reference and warped source image, see \a ZNCCPolicy::similarity() */
+    void similarity(float * out, const float * ref, float * warped, float * tmp1, float * tmp2, float *,
+                    const unsigned int winsize, const int w, const int h, dim3 blocks, dim3 threads)
+    {
+        element_difference(tmp1, ref, warped, absolute, w, h, blocks, threads);
+        windowed_mean_column(tmp2, tmp1, winsize, !absolute, w, h, blocks, threads);
+        windowed_mean_row(tmp1, tmp2, winsize, false, w, h, blocks, threads);
+        const float range = absolute ? DIFFERENCE_SIMILARITY_RANGE
+                                     : DIFFERENCE_SIMILARITY_RANGE * DIFFERENCE_SIMILARITY_RANGE;
+        cost_to_similarity(out, tmp1, 1.f / range, w, h, blocks, threads);
+    }
+};
+
+/** \brief Sum of absolute differences matching cost */
+typedef DifferencePolicy<true> SADPolicy;
+
+/** \brief Sum of squared differences matching cost */
+typedef DifferencePolicy<false> SSDPolicy;
+
+/**
+*  \brief Census transform matching cost with Hamming distance
+*
+*  \details Half of census bits differing, as for unrelated windows, has zero similarity.
+*/
+struct CensusPolicy
+{
+    Image<unsigned int> refcensus;      ///< reference census transform
+    Image<unsigned int> warpedcensus;   ///< warped source census transform
+
+    /** \brief Calculate reference census transform, see \a ZNCCPolicy::prepareReference() */
+    void prepareReference(const float * ref, const unsigned int, const float,
+                          const int w, const int h, dim3 blocks, dim3 threads)
+    {
+        refcensus.reset(w, h);
+        warpedcensus.reset(w, h);
+        census_transform(refcensus.data(), ref, w, h, blocks, threads);
+    }
+
+    /** \brief Calculate similarity of reference and warped source image, see \a ZNCCPolicy::similarity() */
+    void similarity(float * out, const float *, float * warped, float * tmp1, float * tmp2, float *,
+                    const unsigned int winsize, const int w, const int h, dim3 blocks, dim3 threads)
+    {
+        census_transform(warpedcensus.data(), warped, w, h, blocks, threads);
+        hamming_distance(tmp1, refcensus.data(), warpedcensus.data(), w, h, blocks, threads);
+        windowed_mean_column(tmp2, tmp1, winsize, false, w, h, blocks, threads);
+        windowed_mean_row(tmp1, tmp2, winsize, false, w, h, blocks, threads);
+        cost_to_similarity(out, tmp1, 2.f / (CENSUS_WINDOW_SIZE * CENSUS_WINDOW_SIZE - 1), w, h, blocks, threads);
+    }
+};
+
+/** @} */ // group planesweep
+
+#endif // MATCHING_COST_H
@@ -0,0 +1,86 @@
+/**
+ *  \file median_filter.h
+ *  \brief Header file containing MedianFilter class implementation
+ */
+#ifndef MEDIAN_FILTER_H
+#define MEDIAN_FILTER_H
+
+#include "defines.h"
+#include <vector>
+
+/** \addtogroup planesweep
+* @{
+*/
+
+/**
+*  \brief Class that implements constant time median filtering of depthmaps on CPU
+*
+*  \details Depth is quantized to \a MEDIAN_FILTER_BINS levels between near and far plane and median is found from
+* window histogram as in Perreault and Hebert, "Median Filtering in Constant Time". Each image column keeps
+* histogram of its window rows, window histogram is updated by adding and subtracting whole column histograms.
+* Histograms are split into coarse and fine levels, fine level of window histogram is updated lazily only for the
+* coarse bin containing the median, so cost per pixel does not depend on window radius. \a QNAN values are ignored.
+* Image rows are split into bands processed by separate threads.
+*/
+class MedianFilter
+{
+public:
+    /**
+    *  \brief Constructor
+    *
+    *  \param width   image width
+    *  \param height  image height
+    */
+    MedianFilter(unsigned int width, unsigned int height) : w(width), h(height), bins(width * height) {}
+
+    /**
+    *  \brief Set window radius
+    *
+    *  \param radius window is (2 * \p radius + 1) x (2 * \p radius + 1) pixels
+    */
+    void setRadius(unsigned int radius){ r = radius; }
+
+    /**
+    *  \brief Set quantized depth range
+    *
+    *  \param znear   near plane depth
+    *  \param zfar    far plane depth
+    *  \param inverse depth is quantized uniformly in inverse depth if true
+    */
+    void setRange(float znear, float zfar, bool inverse){ this->znear = znear; this->zfar = zfar; this->inverse = inverse; }
+
+    /**
+    *  \brief Filter depthmap
+    *
+    *  \param output output depthmap of \a width * \a height values, may not be same as \p input
+    *  \param input  input depthmap
+    *
+    *  \details Median is the center of its quantization level, unless the filtered pixel itself falls into it,
+    * in which case pixel keeps its depth. Pixels with no valid depth in window are set to \a QNAN.
+    */
+    void compute(float * output, const float * input);
+
+protected:
+
+    /**
+    *  \brief Filter band of rows
+    *
+    *  \param y0     first row of band
+    *  \param y1     row after last row of band
+    *  \param output output depthmap
+    *  \param input  input depthmap
+    */
+    void filterRows(int y0, int y1, float * output, const float * input) const;
+
+    unsigned int w, h;
+    int r = DEFAULT_MEDIAN_RADIUS;
+    float znear = DEFAULT_Z_NEAR;
+    float zfar = DEFAULT_Z_FAR;
+    bool inverse = false;
+
+    std::vector<int> bins;      // quantization level of each pixel, -1 for QNAN
+};
+
+/** @} */ // group planesweep
+
+#endif // MEDIAN_FILTER_H
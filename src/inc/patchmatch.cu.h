@@ -0,0 +1,171 @@
+/**
+ *  \file patchmatch.cu.h
+ *  \brief Header file containing PatchMatch multi-view stereo kernel invocation functions
+ */
+#ifndef PATCHMATCH_CU_H
+#define PATCHMATCH_CU_H
+
+#include <helper_cuda.h>
+#include <cuda_runtime_api.h>
+#include <cuda.h>
+#include <structs.h>
+#include "defines.h"
+
+/** \addtogroup patchmatch  PatchMatch
+* \brief PatchMatch multi-view stereo functions running on GPU
+*
+* \details Each pixel holds plane hypothesis \f$(n_x, n_y, n_z, d)\f$ stored as \a float4, where \f$n\f$ is plane normal
+* in reference camera coordinates and \f$d\f$ is depth at the pixel. Hypotheses are scored by NCC of the window around
+* the pixel warped to each source view by plane induced homography, averaged over source views. Pixels are updated
+* in checkerboard order, so that each half of the pixels reads only hypotheses of the other half.
+* @{
+*/
+
+/**
+ *  \brief Cameras, source views and settings shared by all PatchMatch kernels
+ */
+struct PatchMatchParams
+{
+    Matrix3D K;                                         ///< camera calibration matrix
+    Matrix3D invK;                                      ///< inverse of camera calibration matrix
+    Matrix3D Rrel[PATCHMATCH_MAX_SOURCES];              ///< relative rotations from reference to source views
+    float3 trel[PATCHMATCH_MAX_SOURCES];                ///< relative translations from reference to source views
+    const float * src[PATCHMATCH_MAX_SOURCES];          ///< pointers to source views on the device
+    int srcwidth[PATCHMATCH_MAX_SOURCES];               ///< widths of source views
+    int srcheight[PATCHMATCH_MAX_SOURCES];              ///< heights of source views
+    int nsrc;                                           ///< number of source views
+    int winsize;                                        ///< NCC window size
+    float stdthresh;                                    ///< windows with STD below threshold have zero NCC
+    float znear;                                        ///< near plane depth
+    float zfar;                                         ///< far plane depth
+    bool normals;                                       ///< slanted planes are estimated if true, fronto-parallel otherwise
+};
+
+/**
+ *  \brief Initialize plane hypotheses randomly and score them
+ *
+ *  \param d_plane   pointer to plane hypotheses
+ *  \param d_ncc     pointer to NCC of plane hypotheses
+ *  \param d_ref     pointer to reference image
+ *  \param params    cameras, source views and settings
+ *  \param seed      random number generator seed
+ *  \param width     width of given arrays
+ *  \param height    height of given arrays
+ *  \param blocks    kernel grid dimensions
+ *  \param threads   single block dimensions
+ *
+ *  \details Depth is uniformly distributed in inverse depth between near and far planes
+ */
+void patchmatch_init(float4 * d_plane, float * d_ncc, const float * d_ref, const PatchMatchParams & params,
+                     const unsigned int seed, const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Propagate plane hypotheses from neighbours and refine them randomly for pixels of single checkerboard color
+ *
+ *  \param d_plane   pointer to plane hypotheses
+ *  \param d_ncc     pointer to NCC of plane hypotheses
+ *  \param d_ref     pointer to reference image
+ *  \param params    cameras, source views and settings
+ *  \param parity    checkerboard color, pixels with \f$(x + y) \bmod 2 = parity\f$ are updated
+ *  \param iteration current iteration, random refinement range halves with each iteration
+ *  \param seed      random number generator seed
+ *  \param width     width of given arrays
+ *  \param height    height of given arrays
+ *  \param blocks    kernel grid dimensions
+ *  \param threads   single block dimensions
+ *
+ *  \details Hypotheses of neighbours at distance 1 and 3 along rows and columns are tested
+ */
+void patchmatch_propagate(float4 * d_plane, float * d_ncc, const float * d_ref, const PatchMatchParams & params,
+                          const int parity, const int iteration, const unsigned int seed,
+                          const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Extract depthmap from plane hypotheses
+ *
+ *  \param d_depthmap   pointer to output depthmap
+ *  \param d_plane      pointer to plane hypotheses
+ *  \param d_ncc        pointer to NCC of plane hypotheses
+ *  \param nccthreshold depth of pixels with NCC below threshold is set to \a QNAN
+ *  \param width        width of given arrays
+ *  \param height       height of given arrays
+ *  \param blocks       kernel grid dimensions
+ *  \param threads      single block dimensions
+ */
+void patchmatch_depthmap(float * d_depthmap, const float4 * d_plane, const float * d_ncc, const float nccthreshold,
+                         const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Sweep fronto-parallel planes for pixels of regular grid
+ *
+ *  \param d_depth     pointer to output depth of grid points, \a QNAN where no source view sees the window
+ *  \param d_ncc       pointer to output NCC of grid points
+ *  \param d_ref       pointer to reference image
+ *  \param params      cameras, source views and settings
+ *  \param d_planes    pointer to plane depths on the device
+ *  \param nplanes     number of planes
+ *  \param refine      depth is refined by parabola fit to NCC of neighbouring planes if true
+ *  \param x0          x coordinate of first grid point
+ *  \param y0          y coordinate of first grid point
+ *  \param stride      distance between grid points in pixels
+ *  \param gridwidth   number of grid columns
+ *  \param gridheight  number of grid rows
+ *  \param width       reference image width
+ *  \param height      reference image height
+ *  \param blocks      kernel grid dimensions, covering grid points
+ *  \param threads     single block dimensions
+ *
+ *  \details Each grid point warps only its own window, so cost scales with the number of grid points instead of
+ * image size. Window NCC is averaged over source views as in \a patchmatch_propagate().
+ */
+void patchmatch_grid_sweep(float * d_depth, float * d_ncc, const float * d_ref, const PatchMatchParams & params,
+                           const float * d_planes, const int nplanes, const bool refine,
+                           const int x0, const int y0, const int stride, const int gridwidth, const int gridheight,
+                           const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Insert plane into per pixel list of best candidates
+ *
+ *  \param d_index     pointer to \p ncandidates layers of candidate plane indexes, -1 for empty slots
+ *  \param d_score     pointer to \p ncandidates layers of candidate scores, sorted from best, -2 for empty slots
+ *  \param d_ncc       pointer to score of current plane
+ *  \param plane       index of current plane
+ *  \param ncandidates number of candidates kept per pixel
+ *  \param width       width of single layer
+ *  \param height      height of single layer
+ *  \param blocks      kernel grid dimensions
+ *  \param threads     single block dimensions
+ */
+void candidates_insert(float * d_index, float * d_score, const float * d_ncc, const int plane, const int ncandidates,
+                       const int width, const int height, dim3 blocks, dim3 threads);
+
+/**
+ *  \brief Verify depth candidates with remaining source views and pick best
+ *
+ *  \param d_depth     pointer to output depth of best candidate, \a QNAN if there are no candidates
+ *  \param d_ncc       pointer to output score of best candidate
+ *  \param d_index     pointer to candidate plane indexes from \a candidates_insert()
+ *  \param d_score     pointer to candidate scores from \a candidates_insert(), updated with given source views
+ *  \param d_weight    pointer to number of source views each candidate score is averaged over, initially number of
+ * source views candidates were inserted with, updated with given source views
+ *  \param d_planes    pointer to plane depths
+ *  \param d_ref       pointer to reference image
+ *  \param params      cameras and remaining source views, normals are not used
+ *  \param ncandidates number of candidates per pixel
+ *  \param width       width of single layer
+ *  \param height      height of single layer
+ *  \param blocks      kernel grid dimensions
+ *  \param threads     single block dimensions
+ *
+ *  \details Window NCC of fronto-parallel candidate plane is calculated for remaining source views as in
+ * \a patchmatch_propagate(), so only \p ncandidates hypotheses per pixel are warped instead of all planes.
+ * Candidate score is the average over all source views. Source views beyond \a PATCHMATCH_MAX_SOURCES are verified
+ * by calling the function again with next ones, output depth and score are those of best candidate so far.
+ */
+void candidates_verify(float * d_depth, float * d_ncc, const float * d_index, float * d_score, float * d_weight,
+                       const float * d_planes, const float * d_ref, const PatchMatchParams & params,
+                       const int ncandidates, const int width, const int height, dim3 blocks, dim3 threads);
+
+/** @} */ // group patchmatch
+
+#endif // PATCHMATCH_CU_H
@@ -281,6 +281,12 @@ private:
     */
     uchar3 RGBdepthmapColor(uchar depth);
 
+    /** \brief Show TVL1 denoised depthmap and point cloud */
+    void showDenoised();
+
+    /** \brief Warm started TVL1 denoising after TVL1 parameter change, see \a PlaneSweep::CudaDenoiseUpdate() */
+    void denoiseUpdate();
+
     /** \brief Function to setup planesweep GUI widgets */
     void setupPlanesweep();
 
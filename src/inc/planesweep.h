@@ -9,14 +9,79 @@
 #include "structs.h"
 #include <cuda_runtime_api.h>
 #include <vector>
+#include <map>
+#include <string>
+#include <functional>
+#include <stdint.h>
+#include <climits>
+#include <algorithm>
 #include "cam_image.h"
+#include "homography_cache.h"
 
 typedef unsigned char uchar;
 
+struct GuidedFilter;
+struct MipLevels;
+
 /** \addtogroup planesweep
 * @{
 */
 
+/**
+ *  \brief Enum for selecting how planesweep plane depths are distributed between near and far planes
+ */
+typedef enum PlaneDistribution{
+    UniformDepth,           ///< planes are spaced uniformly in depth
+    UniformInverseDepth,    ///< planes are spaced uniformly in inverse depth
+    UniformDisparity,       ///< planes are spaced uniformly in inverse depth, 1 pixel of disparity apart w.r.t. widest baseline source
+    CustomPlanes            ///< planes are given by \a PlaneSweep::setCustomPlanes()
+} PlaneDistribution;
+
+/**
+ *  \brief Enum for selecting planesweep matching cost
+ */
+typedef enum MatchingCost{
+    ZNCCcost,               ///< zero mean normalized cross correlation
+    SADcost,                ///< sum of absolute differences
+    SSDcost,                ///< sum of squared differences
+    CensusCost              ///< Hamming distance of census transforms
+} MatchingCost;
+
+/**
+ *  \brief Enum for selecting cost volume encoding
+ */
+typedef enum CostVolumeEncoding{
+    CostVolume8U,           ///< cost in range [0,2] quantized to 8 bits
+    CostVolumeHalf          ///< cost stored as half precision float
+} CostVolumeEncoding;
+
+/**
+ *  \brief Cost volume slab consumer
+ *
+ *  \details Called with pointer to slab data, index of first plane in slab and number of planes in slab. Slab holds
+ * \a nplanes consecutive planes of \a width * \a height values each, data is valid only during the call.
+ */
+typedef std::function<void(const void * data, unsigned int firstplane, unsigned int nplanes)> CostVolumeSink;
+
+/**
+ *  \brief Enum for selecting how planesweep depth is refined between discrete planes
+ */
+typedef enum SubplaneRefinement{
+    NoRefinement,           ///< depth of best plane is used
+    ParabolicRefinement,    ///< parabola is fitted to NCC values of best and neighbouring planes
+    EquiangularRefinement   ///< equiangular lines are fitted to NCC values of best and neighbouring planes
+} SubplaneRefinement;
+
+/**
+ *  \brief Single depth measurement of semi-dense depthmap
+ */
+struct DepthPoint{
+    unsigned int x;         ///< pixel column
+    unsigned int y;         ///< pixel row
+    float depth;            ///< depth along reference camera z axis
+    float ncc;              ///< NCC of epipolar match
+};
+
 /**
 *  \brief Class that implements depthmap generation methods using planesweep, TVL1 denoising
 * and TGV Multiview Stereo algorithms
@@ -27,10 +92,10 @@ typedef unsigned char uchar;
 class PlaneSweep
 {
 public:
-    /** \brief Reference image in float format */
+    /** \brief Reference image in float format, call \a ReferenceChanged() after loading it */
     CamImage<float> HostRef;
 
-    /** \brief Source images in float format */
+    /** \brief Source images in float format, call \a SourcesChanged() after loading them */
     std::vector<CamImage<float>> HostSrc;
 
     /** \brief Reference image in unsigned char format */
@@ -66,6 +131,171 @@ public:
     */
     bool RunAlgorithm(int argc, char **argv);
 
+    /**
+    *  \brief Planesweep cost volume generation
+    *
+    *  \param argc      number of command line arguments
+    *  \param argv      pointers to command line argument strings
+    *  \param sink      consumer of cost volume slabs
+    *  \param encoding  cost volume encoding
+    *  \param slabsize  number of planes in single slab
+    *  \return Success/failure of the function
+    *
+    *  \details Cost of each plane is \f$1 - \bar{s}\f$, where \f$\bar{s}\f$ is similarity given by selected matching
+    * cost averaged over source views. Planes are processed in slabs of \p slabsize planes which are passed to \p sink,
+    * so device and host memory stay bounded at any resolution. Plane depths can be retrieved by \a getPlaneDepths().
+    */
+    bool RunCostVolume(int argc, char **argv, const CostVolumeSink & sink,
+                       CostVolumeEncoding encoding = DEFAULT_COST_VOLUME_ENCODING,
+                       unsigned int slabsize = DEFAULT_COST_VOLUME_SLAB_SIZE);
+
+    /**
+    *  \brief Planesweep cost volume generation to file
+    *
+    *  \param argc      number of command line arguments
+    *  \param argv      pointers to command line argument strings
+    *  \param filename  output file name
+    *  \param encoding  cost volume encoding
+    *  \param slabsize  number of planes in single slab
+    *  \return Success/failure of the function
+    *
+    *  \details Cost volume is written as raw plane-major array without header, so the file can be memory mapped
+    * by consumers. See \a RunCostVolume() for details.
+    */
+    bool RunCostVolume(int argc, char **argv, const std::string & filename,
+                       CostVolumeEncoding encoding = DEFAULT_COST_VOLUME_ENCODING,
+                       unsigned int slabsize = DEFAULT_COST_VOLUME_SLAB_SIZE);
+
+    /**
+    *  \brief PatchMatch multi-view stereo
+    *
+    *  \param argc       number of command line arguments
+    *  \param argv       pointers to command line argument strings
+    *  \param iterations number of iterations, each updates both checkerboard colors
+    *  \param normals    slanted planes are estimated if true, fronto-parallel planes otherwise
+    *  \param seed       random number generator seed
+    *  \return Success/failure of the algorithm
+    *
+    *  \details Alternative to \a RunAlgorithm() with cost independent of number of planes. Depth is initialized
+    * randomly between near and far planes, then propagated from neighbours and refined randomly. Window size, STD
+    * and NCC thresholds and number of source views (at most \a PATCHMATCH_MAX_SOURCES) are the same as for planesweep.
+    * Depthmaps can be retrieved the same way as after \a RunAlgorithm().
+    */
+    bool RunPatchMatch(int argc, char **argv, const unsigned int iterations = DEFAULT_PATCHMATCH_ITERATIONS,
+                       const bool normals = DEFAULT_PATCHMATCH_NORMALS, const unsigned int seed = 0);
+
+    /**
+    *  \brief Planesweep with semi-global matching aggregation
+    *
+    *  \param argc   number of command line arguments
+    *  \param argv   pointers to command line argument strings
+    *  \param p1     penalty for depth change of one plane, in 8 bit cost units
+    *  \param p2     penalty for larger depth changes, in 8 bit cost units
+    *  \param paths  number of aggregation paths, 4 or 8
+    *  \return Success/failure of the algorithm
+    *
+    *  \details 8 bit cost volume produced by \a RunCostVolume() is aggregated on CPU, see \a SGM class.
+    * Image is split into strips of full rows, so that cost volume of a strip fits in \a SGM_STRIP_MEMORY bytes.
+    * Each strip is swept and aggregated with \a SGM_STRIP_OVERLAP extra rows above and below it, which are discarded,
+    * so vertical and diagonal paths are truncated at that distance from kept rows. Images that fit in single strip
+    * are aggregated over full paths. Depthmaps can be retrieved the same way as after \a RunAlgorithm().
+    */
+    bool RunSGM(int argc, char **argv, const unsigned int p1 = DEFAULT_SGM_P1, const unsigned int p2 = DEFAULT_SGM_P2,
+                const unsigned int paths = DEFAULT_SGM_PATHS);
+
+    /**
+    *  \brief Planesweep for several reference frames of a sequence sharing source views
+    *
+    *  \param argc      number of command line arguments
+    *  \param argv      pointers to command line argument strings
+    *  \param frames    grayscale frames with camera poses
+    *  \param refs      indexes of reference frames in \p frames
+    *  \param window    frames up to \p window positions before and after reference are candidate source views
+    *  \param depthmaps output depthmaps returned by reference, one for each reference frame
+    *  \param select    source views are chosen by \a SelectSourceViews() if true, otherwise candidates are
+    * used in frame order, starting from the first frame of the window
+    *  \return Success/failure of the algorithm, false if frames differ in size or any of the sweeps failed
+    *
+    *  \details Every frame is uploaded to the device once and shared by all references using it. For each reference
+    * at most \a getNumberofImages() candidates are used and \a RunAlgorithm() is run. \a HostRef, \a HostSrc and
+    * source view selection are restored afterwards, also when an exception is caught, while depthmaps retrieved
+    * by getters are those of the last reference.
+    */
+    bool RunBatch(int argc, char **argv, const std::vector<CamImage<float>> & frames,
+                  const std::vector<unsigned int> & refs, const unsigned int window,
+                  std::vector<CamImage<float>> & depthmaps, const bool select = true);
+
+    /**
+    *  \brief Semi-dense depth estimation by epipolar line search
+    *
+    *  \param argc       number of command line arguments
+    *  \param argv       pointers to command line argument strings
+    *  \param gradthresh pixels with reference intensity gradient along epipolar line below threshold are skipped
+    *  \return Success/failure of the algorithm
+    *
+    *  \details Only high gradient pixels are matched, by 1D patch search along epipolar lines of up to
+    * \a EPIPOLAR_MAX_SOURCES source views between near and far planes. STD and NCC thresholds and number of
+    * source views are the same as for planesweep. Results can be retrieved by \a getSemiDenseDepthmap(),
+    * \a getSemiDenseMask() and \a getSemiDensePoints(). Semi-dense depthmap holds 0 where there is no depth, so it
+    * can be passed directly to \a TGVdenoiseFromSparse().
+    */
+    bool RunSemiDense(int argc, char **argv, const float gradthresh = DEFAULT_SEMIDENSE_GRADIENT);
+
+    /**
+    *  \brief ZNCC disparity search for rectified stereo pair on CPU
+    *
+    *  \param index index of source view in \a HostSrc
+    *  \return Success/failure of the algorithm, false if reference and source views are not a rectified pair of the
+    * same size
+    *
+    *  \details Integer disparities between near and far planes are searched with running window sums, see
+    * \a RectifiedStereo class. Window size and thresholds are the same as for planesweep. Called automatically by
+    * \a RunAlgorithm() for single rectified source view, see \a setRectifiedFastPath().
+    * Depthmaps can be retrieved the same way as after \a RunAlgorithm().
+    */
+    bool RunRectified(const unsigned int index = 0);
+
+    /**
+    *  \brief Make current reference view the depth filter keyframe
+    *
+    *  \param argc   number of command line arguments
+    *  \param argv   pointers to command line argument strings
+    *  \param reset  discard existing filter state if true
+    *  \return Success/failure of the function
+    *
+    *  \details Existing per pixel filter state is propagated from previous keyframe to reference view pose,
+    * pixels without propagated state are initialized over whole range between near and far planes.
+    */
+    bool DepthFilterKeyframe(int argc, char **argv, const bool reset = false);
+
+    /**
+    *  \brief Update depth filter with new frame
+    *
+    *  \param argc       number of command line arguments
+    *  \param argv       pointers to command line argument strings
+    *  \param frame      grayscale frame with camera pose, e.g. one of \a HostSrc
+    *  \param gradthresh keyframe pixels with intensity gradient along epipolar line below threshold are skipped
+    *  \return Success/failure of the function
+    *
+    *  \details Every active keyframe pixel is searched along its epipolar line in \p frame around current
+    * inverse depth estimate, see \a depth_filter_update(). Filter state and list of active pixels stay on the device,
+    * only \p frame is uploaded, so cost depends on number of active pixels only.
+    * Requires keyframe set by \a DepthFilterKeyframe().
+    */
+    bool DepthFilterUpdate(int argc, char **argv, const CamImage<float> & frame,
+                           const float gradthresh = DEFAULT_SEMIDENSE_GRADIENT);
+
+    /**
+    *  \brief Export converged depth filter pixels as depthmap
+    *
+    *  \return Number of converged pixels
+    *
+    *  \details Pixels whose inverse depth standard deviation is below \a DEPTH_FILTER_CONVERGED_STD of inverse
+    * depth range and inlier ratio is above \a DEPTH_FILTER_CONVERGED_INLIER are written to depthmap, other pixels are
+    * set to far plane depth. Depthmaps can be retrieved the same way as after \a RunAlgorithm().
+    */
+    unsigned int DepthFilterExport();
+
     /**
     *  \brief \a OpenCV TVL1 denoising on CPU
     *
@@ -82,6 +312,163 @@ public:
     */
     bool Denoise(unsigned int niter, double lambda);
 
+    /**
+    *  \brief Multiscale TVL1 denoising on GPU
+    *
+    *  \param argc        number of command line arguments
+    *  \param argv        pointers to command line argument strings
+    *  \param levels      number of pyramid levels including full resolution
+    *  \param coarseiters number of iterations on each coarse level
+    *  \param fineiters   number of iterations on full resolution
+    *  \param lambda      TVL1 parameter \f$\lambda\f$
+    *  \param tau         TVL1 parameter \f$\tau\f$
+    *  \param sigma       TVL1 parameter \f$\sigma\f$
+    *  \param theta       TVL1 parameter \f$\theta\f$
+    *  \param beta        TVL1 parameter \f$\beta\f$
+    *  \param gamma       TVL1 parameter \f$\gamma\f$
+    *  \return Success/failure of the function
+    *
+    *  \details Normalized depthmap and reference image are downsampled by factors of 2 down to \a MIN_MIP_SIZE.
+    * Coarsest level is solved from its input, primal and dual variables of each level are then bilinearly upsampled
+    * to warm start the next finer one, so large flat regions converge in few full resolution iterations. Results are
+    * stored as in \a CudaDenoise(), \a getDenoiseIterations() returns iterations summed over levels.
+    */
+    bool CudaDenoiseMultiscale(int argc, char **argv, const unsigned int levels = DEFAULT_TVL1_LEVELS,
+                               const unsigned int coarseiters = DEFAULT_TVL1_COARSE_ITERATIONS,
+                               const unsigned int fineiters = DEFAULT_TVL1_FINE_ITERATIONS,
+                               const double lambda = DEFAULT_TVL1_LAMBDA, const double tau = DEFAULT_TVL1_TAU,
+                               const double sigma = DEFAULT_TVL1_SIGMA, const double theta = DEFAULT_TVL1_THETA,
+                               const double beta = DEFAULT_TVL1_BETA, const double gamma = DEFAULT_TVL1_GAMMA);
+
+    /**
+    *  \brief TVL1 denoising on GPU warm started from previous call
+    *
+    *  \param argc        number of command line arguments
+    *  \param argv        pointers to command line argument strings
+    *  \param niters      number of iterations when solving from scratch
+    *  \param updateiters number of iterations when warm started
+    *  \param lambda      TVL1 parameter \f$\lambda\f$
+    *  \param tau         TVL1 parameter \f$\tau\f$
+    *  \param sigma       TVL1 parameter \f$\sigma\f$
+    *  \param theta       TVL1 parameter \f$\theta\f$
+    *  \param beta        TVL1 parameter \f$\beta\f$
+    *  \param gamma       TVL1 parameter \f$\gamma\f$
+    *  \return Success/failure of the function
+    *
+    *  \details Primal and dual variables are kept on the device between calls. While no algorithm has produced a new
+    * depthmap and depth range stays the same, iterations continue from kept solution, so changing only TVL1 parameters
+    * needs \p updateiters iterations instead of \p niters. Results are stored as in \a CudaDenoise(). Kept state is
+    * freed by \a cudaReset().
+    */
+    bool CudaDenoiseUpdate(int argc, char **argv, const unsigned int niters = DEFAULT_TVL1_ITERATIONS,
+                           const unsigned int updateiters = DEFAULT_TVL1_UPDATE_ITERATIONS,
+                           const double lambda = DEFAULT_TVL1_LAMBDA, const double tau = DEFAULT_TVL1_TAU,
+                           const double sigma = DEFAULT_TVL1_SIGMA, const double theta = DEFAULT_TVL1_THETA,
+                           const double beta = DEFAULT_TVL1_BETA, const double gamma = DEFAULT_TVL1_GAMMA);
+
+    /**
+    *  \brief Set stopping tolerance of \a CudaDenoise()
+    *
+    *  \param tolerance iterations stop when relative change \f$\|u^{n+1} - u^n\| / \|u^{n+1}\|\f$ is not above
+    * \p tolerance, 0 runs all iterations
+    *  \param interval  change is evaluated every \p interval iterations
+    *
+    *  \details Number of iterations passed to \a CudaDenoise() becomes the upper limit, iterations actually used
+    * are returned by \a getDenoiseIterations().
+    */
+    void setDenoiseTolerance(double tolerance, unsigned int interval = DEFAULT_TVL1_CHECK_INTERVAL){
+        tvl1tolerance = tolerance; tvl1checkinterval = interval; }
+
+    /**
+    *  \brief Get number of iterations used by last \a CudaDenoise()
+    *
+    *  \return Number of TVL1 iterations
+    */
+    unsigned int getDenoiseIterations() const { return tvl1iterations; }
+
+    /**
+    *  \brief TVL1 denoising on CPU
+    *
+    *  \param niters number of denoising iterations
+    *  \param lambda TVL1 parameter \f$\lambda\f$
+    *  \param tau    TVL1 parameter \f$\tau\f$
+    *  \param sigma  TVL1 parameter \f$\sigma\f$
+    *  \param theta  TVL1 parameter \f$\theta\f$
+    *  \param beta   TVL1 parameter \f$\beta\f$
+    *  \param gamma  TVL1 parameter \f$\gamma\f$
+    *  \return Success/failure of the function
+    *
+    *  \details Multithreaded \a TVL1Solver running the same iterations as \a CudaDenoise() on floating point depth.
+    * Depthmaps can be retrieved by calling \a getDepthmapDenoised() and \a getDepthmap8uDenoised() functions.
+    * \a getDepthmapDenoisedPtr() is not updated. If there is no depthmap, function returns false.
+    */
+    bool CpuDenoise(const unsigned int niters = DEFAULT_TVL1_ITERATIONS, const double lambda = DEFAULT_TVL1_LAMBDA,
+                    const double tau = DEFAULT_TVL1_TAU, const double sigma = DEFAULT_TVL1_SIGMA, const double theta = DEFAULT_TVL1_THETA,
+                    const double beta = DEFAULT_TVL1_BETA, const double gamma = DEFAULT_TVL1_GAMMA);
+
+    /**
+    *  \brief TVL1 denoising of many depthmaps of reference view on CPU
+    *
+    *  \param depthmaps input depthmaps of \a HostRef, same size and camera pose as \a HostRef
+    *  \param denoised  denoised depthmaps in the same order, camera matrices are copied from inputs
+    *  \param niters    number of denoising iterations
+    *  \param lambda    TVL1 parameter \f$\lambda\f$
+    *  \param tau       TVL1 parameter \f$\tau\f$
+    *  \param sigma     TVL1 parameter \f$\sigma\f$
+    *  \param theta     TVL1 parameter \f$\theta\f$
+    *  \param beta      TVL1 parameter \f$\beta\f$
+    *  \param gamma     TVL1 parameter \f$\gamma\f$
+    *  \return Success/failure of the function
+    *
+    *  \details Same iterations as \a CpuDenoise(), but \a TVL1_BATCH_LANES depthmaps at a time are solved together by
+    * \a TVL1BatchSolver, which shares anisotropic diffusion tensor of \a HostRef between all of them. Depths are
+    * normalized by current depth range. Function returns false if any depthmap has different camera pose than
+    * \a HostRef, use overload with guide images for depthmaps of different reference views.
+    */
+    bool CpuDenoiseBatch(const std::vector<CamImage<float>> & depthmaps, std::vector<CamImage<float>> & denoised,
+                         const unsigned int niters = DEFAULT_TVL1_ITERATIONS, const double lambda = DEFAULT_TVL1_LAMBDA,
+                         const double tau = DEFAULT_TVL1_TAU, const double sigma = DEFAULT_TVL1_SIGMA,
+                         const double theta = DEFAULT_TVL1_THETA, const double beta = DEFAULT_TVL1_BETA,
+                         const double gamma = DEFAULT_TVL1_GAMMA);
+
+    /**
+    *  \brief TVL1 denoising of depthmaps of several reference views on CPU
+    *
+    *  \param depthmaps input depthmaps, e.g. output of \a RunBatch()
+    *  \param guides    grayscale reference images with camera poses, e.g. frames passed to \a RunBatch()
+    *  \param denoised  denoised depthmaps in the same order, camera matrices are copied from inputs
+    *  \param niters    number of denoising iterations
+    *  \param lambda    TVL1 parameter \f$\lambda\f$
+    *  \param tau       TVL1 parameter \f$\tau\f$
+    *  \param sigma     TVL1 parameter \f$\sigma\f$
+    *  \param theta     TVL1 parameter \f$\theta\f$
+    *  \param beta      TVL1 parameter \f$\beta\f$
+    *  \param gamma     TVL1 parameter \f$\gamma\f$
+    *  \return Success/failure of the function, false if any depthmap has no guide of the same camera pose
+    *
+    *  \details Each depthmap is guided by the first of \p guides with its camera pose. Depthmaps sharing a guide are
+    * solved \a TVL1_BATCH_LANES at a time with anisotropic diffusion tensor of that guide, see \a CpuDenoiseBatch().
+    */
+    bool CpuDenoiseBatch(const std::vector<CamImage<float>> & depthmaps, const std::vector<CamImage<float>> & guides,
+                         std::vector<CamImage<float>> & denoised,
+                         const unsigned int niters = DEFAULT_TVL1_ITERATIONS, const double lambda = DEFAULT_TVL1_LAMBDA,
+                         const double tau = DEFAULT_TVL1_TAU, const double sigma = DEFAULT_TVL1_SIGMA,
+                         const double theta = DEFAULT_TVL1_THETA, const double beta = DEFAULT_TVL1_BETA,
+                         const double gamma = DEFAULT_TVL1_GAMMA);
+
+    /**
+    *  \brief Constant time median filtering of depthmap on CPU
+    *
+    *  \param radius window is (2 * \p radius + 1) x (2 * \p radius + 1) pixels
+    *  \param passes number of filter passes
+    *  \return Success/failure of filtering
+    *
+    *  \details Fast alternative to TVL1 denoising, see \a MedianFilter. Depth is quantized in depth or inverse depth
+    * according to plane distribution. Filtered depthmap is accessed with \a getDepthmapDenoised() and
+    * \a getDepthmap8uDenoised() functions.
+    */
+    bool MedianDenoise(unsigned int radius = DEFAULT_MEDIAN_RADIUS, unsigned int passes = DEFAULT_MEDIAN_PASSES);
+
     /**
     *  \brief TVL1 denoising on GPU
     *
@@ -155,6 +542,72 @@ public:
     void RelativeMatrices(Matrix3D & Rrel, Vector3D & trel, const Matrix3D & Rref,
                           const Vector3D & tref, const Matrix3D & Rsrc, const Vector3D & tsrc) const;
 
+    /**
+    *  \brief Check if reference and source view are a rectified pair
+    *
+    *  \param baseline signed baseline along x axis returned by reference
+    *  \param index    index of source view in \a HostSrc
+    *  \return True if relative rotation is identity and relative translation is along x axis,
+    * within \a RECTIFIED_TOLERANCE
+    *
+    *  \details Holds for KITTI image_00/01 and image_02/03 pairs of the same frame in rectified camera coordinates
+    */
+    bool isRectifiedPair(float & baseline, const unsigned int index = 0) const;
+
+    /**
+    *  \brief Score source view for planesweep
+    *
+    *  \param index index of source view in \a HostSrc
+    *  \return Score, 0 if overlap with reference view is below \a SOURCE_SELECTION_MIN_OVERLAP
+    *
+    *  \details Grid of \a SOURCE_SELECTION_GRID x \a SOURCE_SELECTION_GRID reference pixels is placed at depth
+    * halfway between near and far planes in inverse depth. Every point visible in source view adds Gaussian score
+    * of its triangulation angle, centered at \a SOURCE_SELECTION_ANGLE. Score is normalized by number of points,
+    * so it favours views with good triangulation angle and large overlap. Near duplicates score close to 0.
+    */
+    float SourceViewScore(const unsigned int index) const;
+
+    /**
+    *  \brief Select best source views by their scores
+    *
+    *  \param k largest number of views to select
+    *  \return Number of selected views
+    *
+    *  \details Views with nonzero \a SourceViewScore() are ranked and the best \p k are used in given order by all
+    * algorithms instead of the first entries of \a HostSrc. Selection is kept until \a clearSourceViewSelection()
+    * or next call, so it has to be redone whenever \a HostSrc changes. If no view qualifies, 0 is returned and
+    * selection is cleared, so callers have to decide which views to use, otherwise first entries of \a HostSrc are used.
+    */
+    unsigned int SelectSourceViews(const unsigned int k);
+
+    /**
+    *  \brief Use first entries of \a HostSrc again
+    */
+    void clearSourceViewSelection(){ sourceviews.clear(); }
+
+    /**
+    *  \brief Get selected source views
+    *
+    *  \return Indexes of selected views in \a HostSrc, empty if there is no selection
+    */
+    const std::vector<unsigned int> & getSourceViews() const { return sourceviews; }
+
+    /**
+    *  \brief Mark \a HostRef as changed
+    *
+    *  \details Data derived from reference image and kept on the device between calls, such as anisotropic diffusion
+    * tensor, is recalculated after this call. It has to be called whenever \a HostRef is loaded or written directly.
+    */
+    void ReferenceChanged(){ refgeneration++; }
+
+    /**
+    *  \brief Mark \a HostSrc as changed
+    *
+    *  \details Cached source view results are not reused after this call. It has to be called whenever images of
+    * \a HostSrc are loaded or written directly, see \a setSourceMapCaching().
+    */
+    void SourcesChanged(){ sourcegeneration++; }
+
     // Setters:
     /**
     *  \brief Control relative matrix calculation method
@@ -215,6 +668,152 @@ public:
     */
     void setNumberofPlanes(unsigned int n){ numberplanes = n; }
 
+    /**
+    *  \brief Set planesweep plane depth distribution
+    *
+    *  \param dist plane depth distribution
+    *
+    *  \details Must be set before using \a RunAlgorithm(). With \a UniformDisparity number of planes
+    * set by \a setNumberofPlanes() is used as an upper limit.
+    */
+    void setPlaneDistribution(PlaneDistribution dist){ planedistribution = dist; }
+
+    /**
+    *  \brief Set custom list of planesweep plane depths
+    *
+    *  \param depths plane depths
+    *  \return False if \p depths has no positive depths, in which case nothing is changed
+    *
+    *  \details Must be set before using \a RunAlgorithm(). Plane distribution is set to \a CustomPlanes,
+    * number of planes and near and far plane depths are set from \p depths so that depthmap normalization
+    * stays consistent with the planes used. \a CustomPlanes without any planes set falls back to \a UniformDepth.
+    */
+    bool setCustomPlanes(const std::vector<float> & depths);
+
+    /**
+    *  \brief Set planesweep sub-plane depth refinement method
+    *
+    *  \param method sub-plane refinement method
+    *
+    *  \details Must be set before using \a RunAlgorithm(). Refinement allows using fewer planes without
+    * depth quantization showing up in the depthmap.
+    */
+    void setSubplaneRefinement(SubplaneRefinement method){ subplanerefinement = method; }
+
+    /**
+    *  \brief Set planesweep matching cost
+    *
+    *  \param cost matching cost
+    *
+    *  \details Must be set before using \a RunAlgorithm(). Costs other than ZNCC are converted to similarity
+    * in range [-1,1] with unrelated windows around 0 as for NCC, so NCC threshold has comparable meaning for all of
+    * them. SAD and SSD reach zero similarity at mean absolute difference of \a DIFFERENCE_SIMILARITY_RANGE and census
+    * when half of the bits differ, see matching_cost.h. SAD, SSD and census trade accuracy for throughput.
+    */
+    void setMatchingCost(MatchingCost cost){ matchingcost = cost; }
+
+    /**
+    *  \brief Restrict \a RunAlgorithm() to region of interest
+    *
+    *  \param x      first column of region
+    *  \param y      first row of region
+    *  \param width  region width, 0 for whole image
+    *  \param height region height, 0 for whole image
+    *
+    *  \details Planesweep runs on reference crop extended by window halo, so warps, windows and aggregation
+    * touch only requested pixels and their neighbourhood. Depthmap keeps full reference size, pixels outside of
+    * region are set to far plane depth.
+    */
+    void setROI(unsigned int x, unsigned int y, unsigned int width, unsigned int height){
+        roix = x; roiy = y; roiw = width; roih = height; }
+
+    /**
+    *  \brief Compute depth in \a RunAlgorithm() only on regular grid
+    *
+    *  \param s distance between grid points in pixels, 1 for dense depthmap
+    *
+    *  \details Grid starts at top left corner of region of interest. Each grid point sweeps only its own window,
+    * see \a patchmatch_grid_sweep(), and at most \a PATCHMATCH_MAX_SOURCES source views are used. Depth of grid
+    * points is written to depthmap (other pixels are set to far plane depth) and to \a getGridPoints().
+    */
+    void setStride(unsigned int s){ stride = std::max(s, 1u); }
+
+    /**
+    *  \brief Enable or disable mip-mapped source view sampling
+    *
+    *  \param enable planesweep warps sample source view pyramid level matching local homography scale if true,
+    * see \a warp_mipmapped()
+    */
+    void setMipmapping(bool enable){ mipmapping = enable; }
+
+    /**
+    *  \brief Enable or disable candidate pruning in ZNCC planesweep
+    *
+    *  \param enable     \a RunAlgorithm() sweeps all planes only against first \p sources source views if true
+    *  \param candidates number of best depth candidates kept per pixel
+    *  \param sources    number of source views swept with all planes
+    *
+    *  \details Remaining source views only verify kept candidates, \a PATCHMATCH_MAX_SOURCES at a time, see
+    * \a candidates_verify(). Source views are used in order of \a SelectSourceViews(), so the best ones are swept.
+    * Sub-plane refinement and source view map caching are not used with pruning.
+    */
+    void setCandidatePruning(bool enable, unsigned int candidates = DEFAULT_PRUNING_CANDIDATES,
+                             unsigned int sources = DEFAULT_PRUNING_SOURCES){
+        candidatepruning = enable; pruningcandidates = std::max(candidates, 1u); pruningsources = std::max(sources, 1u); }
+
+    /**
+    *  \brief Enable or disable depth confidence calculation
+    *
+    *  \param enable \a RunAlgorithm() calculates confidence from NCC peak sharpness and second best ratio if true,
+    * see \a getConfidence()
+    *
+    *  \details Confidence is not calculated by rectified, pruned and strided sweeps, \a getConfidence() returns
+    * \a nullptr after them, so fusion is not gated by confidence there. Source view map cache is not used while
+    * enabled, so it should be enabled only for runs whose confidence is needed.
+    */
+    void setConfidenceMaps(bool enable){ confidencemaps = enable; }
+
+    /**
+    *  \brief Enable or disable rectified stereo fast path
+    *
+    *  \param enable \a RunAlgorithm() calls \a RunRectified() if true, there is single source view forming rectified
+    * pair with reference view, matching cost is ZNCC and guided filter is disabled
+    *
+    *  \details Fast path searches disparities directly and does not use cached homography tables.
+    */
+    void setRectifiedFastPath(bool enable){ rectifiedfastpath = enable; }
+
+    /**
+    *  \brief Enable or disable guided filter aggregation of similarity slices
+    *
+    *  \param enable similarity of each plane is filtered with reference image as guide before best plane selection if true
+    *  \param radius filter radius
+    *  \param eps    regularization parameter \f$\epsilon\f$, in squared intensity units
+    *
+    *  \details Must be set before using \a RunAlgorithm(). Filtering cost does not depend on \p radius.
+    */
+    void setGuidedFilter(bool enable, unsigned int radius = DEFAULT_GUIDED_FILTER_RADIUS, float eps = DEFAULT_GUIDED_FILTER_EPS){
+        guidedfilter = enable; guidedradius = radius; guidedeps = eps; }
+
+    /**
+    *  \brief Enable or disable caching of per source view depthmaps and NCC values
+    *
+    *  \param cache    per source view results are cached if true, cache is cleared otherwise
+    *  \param compress cached results are stored as 16 bit values if true
+    *
+    *  \details Cached results are keyed by identity of reference and source images, camera matrices, plane depths
+    * and planesweep parameters, image contents are not compared, so \a ReferenceChanged() and \a SourcesChanged()
+    * have to be called after loading views. Changing only NCC threshold or number of source images afterwards
+    * re-aggregates cached results in \a RunAlgorithm() instead of sweeping again.
+    */
+    void setSourceMapCaching(bool cache, bool compress = false){ cachesourcemaps = cache; compresssourcemaps = compress;
+                                                                 if (!cache) clearSourceMapCache(); }
+
+    /**
+    *  \brief Clear cached per source view depthmaps and NCC values
+    */
+    void clearSourceMapCache(){ sourcemaps.clear(); }
+
     /**
     *  \brief Set planesweep number of images to run algorithm on
     *
@@ -286,6 +885,13 @@ public:
     */
     bool getAlternativeRelativeMatrixMethod() const { return alternativemethod; }
 
+    /**
+    *  \brief Get depth confidence calculation setting
+    *
+    *  \return True if \a RunAlgorithm() calculates confidence, see \a setConfidenceMaps()
+    */
+    bool getConfidenceMaps() const { return confidencemaps; }
+
     /**
     *  \brief Get camera calibration matrix \f$K\f$
     *  \return Camera calibration matrix
@@ -344,6 +950,16 @@ public:
     */
     CamImage<uchar> * getDepthmap8uDenoised(){ return &depthmap8udenoised; }
 
+    /**
+    *  \brief Get pointer to per pixel depth confidence
+    *
+    *  \return pointer to confidence in range [0,1], \a nullptr if last \a RunAlgorithm() did not calculate it
+    *
+    *  \details Confidence is calculated if enabled with \a setConfidenceMaps(), see \a sum_confidence(). Pixels
+    * without depth have zero confidence.
+    */
+    CamImage<float> * getConfidence(){ return confidenceavailable ? &confidence : nullptr; }
+
     /**
     *  \brief Get pointer to TGV depthmap
     *
@@ -362,6 +978,36 @@ public:
     */
     CamImage<uchar> * getDepthmap8uTGV(){ return &depthmap8uTGV; }
 
+    /**
+    *  \brief Get depth measurements of grid points
+    *
+    *  \return list of grid points with depth found by last strided \a RunAlgorithm(), in row major order
+    */
+    const std::vector<DepthPoint> & getGridPoints() const { return gridpoints; }
+
+    /**
+    *  \brief Get pointer to semi-dense depthmap
+    *
+    *  \return pointer to semi-dense depthmap
+    *
+    *  \details Depthmap returned is the last one calculated by running \a RunSemiDense(), 0 where there is no depth
+    */
+    CamImage<float> * getSemiDenseDepthmap(){ return &semidensedepth; }
+
+    /**
+    *  \brief Get pointer to semi-dense depthmap mask
+    *
+    *  \return pointer to mask, 1 where semi-dense depth is available and 0 otherwise
+    */
+    CamImage<uchar> * getSemiDenseMask(){ return &semidensemask; }
+
+    /**
+    *  \brief Get semi-dense depth measurements
+    *
+    *  \return list of pixels with depth found by last \a RunSemiDense(), in row major order
+    */
+    const std::vector<DepthPoint> & getSemiDensePoints() const { return semidensepoints; }
+
     /**
     *  \brief Get 3D coordinates of each camera pixel
     *
@@ -394,6 +1040,36 @@ public:
     */
     unsigned int getNumberofPlanes() const { return numberplanes; }
 
+    /**
+    *  \brief Get currently set planesweep plane depth distribution
+    *
+    *  \return Planesweep plane depth distribution
+    */
+    PlaneDistribution getPlaneDistribution() const { return planedistribution; }
+
+    /**
+    *  \brief Get plane depths used by planesweep
+    *
+    *  \return Plane depths in ascending order
+    *
+    *  \details Plane depths returned are the ones used by the last \a RunAlgorithm() call
+    */
+    const std::vector<float> & getPlaneDepths() const { return planes; }
+
+    /**
+    *  \brief Get currently set planesweep sub-plane depth refinement method
+    *
+    *  \return Sub-plane refinement method
+    */
+    SubplaneRefinement getSubplaneRefinement() const { return subplanerefinement; }
+
+    /**
+    *  \brief Get currently set planesweep matching cost
+    *
+    *  \return Matching cost
+    */
+    MatchingCost getMatchingCost() const { return matchingcost; }
+
     /**
     *  \brief Get currently set planesweep number of source images
     *
@@ -448,9 +1124,29 @@ protected:
     CamImage<uchar> depthmap8udenoised;
     CamImage<float> depthmapTGV;
     CamImage<uchar> depthmap8uTGV;
-
-    // pointer to depthmap on the device after TVL1 denoising
+    CamImage<float> confidence;
+    CamImage<float> semidensedepth;
+    CamImage<uchar> semidensemask;
+    std::vector<DepthPoint> semidensepoints;
+    std::vector<DepthPoint> gridpoints;
+
+    // depth filter keyframe and per pixel state (inverse depth mean, variance, Beta distribution counts),
+    // state is kept on the device and downloaded to filterstate only by DepthFilterExport()
+    CamImage<float> filterkeyframe;
+    CamImage<float4> filterstate;
+
+    // depth filter state, keyframe, frame buffer and active pixel lists on the device, freed in cudaReset()
+    Image<float4> devfilterstate;
+    Image<float> devfilterkeyframe, devfilterframe;
+    std::vector<Image<int>> devfilterlists;
+    Image<unsigned int> devfiltercount;
+    unsigned int filterlist = 0;
+    unsigned int filteractive = 0;
+
+    // pointer to depthmap on the device after TVL1 denoising, its pitch and size
     float * d_depthmap;
+    size_t d_depthmappitch = 0;
+    int d_depthmapw = 0, d_depthmaph = 0;
 
     // stored coordinates
     CamImage<float> coord_x, coord_y, coord_z;
@@ -463,6 +1159,158 @@ protected:
     unsigned int winsize = DEFAULT_WINDOW_SIZE;
     float stdthresh = DEFAULT_STD_THRESHOLD;
     float nccthresh = DEFAULT_NCC_THRESHOLD;
+    PlaneDistribution planedistribution = DEFAULT_PLANE_DISTRIBUTION;
+    SubplaneRefinement subplanerefinement = DEFAULT_SUBPLANE_REFINEMENT;
+    MatchingCost matchingcost = DEFAULT_MATCHING_COST;
+    bool guidedfilter = false;
+    unsigned int guidedradius = DEFAULT_GUIDED_FILTER_RADIUS;
+    float guidedeps = DEFAULT_GUIDED_FILTER_EPS;
+    bool rectifiedfastpath = DEFAULT_RECTIFIED_FAST_PATH;
+    bool mipmapping = DEFAULT_SOURCE_MIPMAPS;
+    double tvl1tolerance = 0;
+    unsigned int tvl1checkinterval = DEFAULT_TVL1_CHECK_INTERVAL;
+    unsigned int tvl1iterations = 0;
+    bool candidatepruning = false;
+    bool confidencemaps = false;
+    bool confidenceavailable = false;
+    unsigned int pruningcandidates = DEFAULT_PRUNING_CANDIDATES;
+    unsigned int pruningsources = DEFAULT_PRUNING_SOURCES;
+
+    // region of interest, grid stride and flag set while reference view is cropped to region
+    unsigned int roix = 0, roiy = 0, roiw = 0, roih = 0;
+    unsigned int stride = 1;
+    bool cropped = false;
+
+    /**
+    *  \brief Run planesweep on region of interest or grid
+    *
+    *  \param argc number of command line arguments
+    *  \param argv pointers to command line argument strings
+    *  \return Success/failure of the algorithm
+    */
+    bool RunRegion(int argc, char **argv);
+
+    /**
+    *  \brief Run planesweep on grid points inside region
+    *
+    *  \param argc number of command line arguments
+    *  \param argv pointers to command line argument strings
+    *  \param x0   first column of region
+    *  \param y0   first row of region
+    *  \param x1   column after last column of region
+    *  \param y1   row after last row of region
+    *  \return Success/failure of the algorithm
+    */
+    bool RunGrid(int argc, char **argv, const int x0, const int y0, const int x1, const int y1);
+
+    // source views kept on the device during batch processing, keyed by host data
+    bool sharesources = false;
+    std::map<const float *, std::vector<Image<float>>> devicesources;
+
+    /**
+    *  \brief Get \p i-th source view on the device
+    *
+    *  \param i     source view number, see \a Source()
+    *  \param local device image to upload source view to if it is not shared
+    *  \return Pointer to source view on the device
+    */
+    const float * DeviceSource(const unsigned int i, Image<float> & local);
+
+    /**
+    *  \brief Get pyramid of \p i-th source view on the device
+    *
+    *  \param i       source view number, see \a Source()
+    *  \param local   device images to build pyramid in if source view is not shared
+    *  \param nlevels largest number of levels, levels smaller than \a MIN_MIP_SIZE are not built
+    *  \return Pointers to pyramid levels
+    *
+    *  \details Shared pyramids are built once and extended when more levels are requested
+    */
+    MipLevels DeviceSourceLevels(const unsigned int i, std::vector<Image<float>> & local, const int nlevels);
+
+    // anisotropic diffusion tensor of reference image shared by TVL1 and TGV, freed in cudaReset()
+    std::vector<Image<float>> devicetensor;
+    uint64_t tensorkey = 0;
+
+    // incremented by ReferenceChanged() whenever HostRef is loaded and by SourcesChanged() whenever HostSrc is loaded
+    uint64_t refgeneration = 0;
+    uint64_t sourcegeneration = 0;
+
+    // TVL1 state kept by CudaDenoiseUpdate(), freed in cudaReset()
+    enum TVL1State { TVL1Input, TVL1RawInput, TVL1U, TVL1R, TVL1Px, TVL1Py, TVL1StateCount };
+    std::vector<Image<float>> tvl1state;
+    uint64_t tvl1statekey = 0;
+
+    /**
+    *  \brief Get anisotropic diffusion tensor of reference image on the device
+    *
+    *  \param beta  TVL1 parameter \f$\beta\f$
+    *  \param gamma TVL1 parameter \f$\gamma\f$
+    *  \return Tensor elements T11, T12, T21 and T22
+    *
+    *  \details Tensor is recalculated only when \a ReferenceChanged() was called, or size of reference image,
+    * \p beta or \p gamma have changed.
+    */
+    const std::vector<Image<float>> & DeviceTensor(const double beta, const double gamma);
+
+    /**
+    *  \brief Allocate \a d_depthmap for depthmap of given size
+    *
+    *  \param w depthmap width
+    *  \param h depthmap height
+    *  \return Pitch of \a d_depthmap in bytes
+    *
+    *  \details Memory is kept between calls and reallocated only when size has changed.
+    */
+    size_t DeviceDepthmap(const int w, const int h);
+
+    /**
+    *  \brief Batched TVL1 denoising of depthmaps guided by reference images of the same camera pose
+    *
+    *  \details Shared by both \a CpuDenoiseBatch() overloads, parameters are the same.
+    */
+    bool DenoiseBatchGuided(const std::vector<CamImage<float>> & depthmaps,
+                            const std::vector<const CamImage<float> *> & guides, std::vector<CamImage<float>> & denoised,
+                            const unsigned int niters, const double lambda, const double tau, const double sigma,
+                            const double theta, const double beta, const double gamma);
+
+    // indexes of selected source views in HostSrc, empty if all are used in order
+    std::vector<unsigned int> sourceviews;
+
+    /** \brief Index in \a HostSrc of \p i-th source view used by algorithms */
+    unsigned int SourceIndex(const unsigned int i) const {
+        return (i < sourceviews.size()) && (sourceviews[i] < HostSrc.size()) ? sourceviews[i] : i; }
+
+    /** \brief \p i-th source view used by algorithms */
+    const CamImage<float> & Source(const unsigned int i) const { return HostSrc[SourceIndex(i)]; }
+
+    /** \brief Number of source views used by algorithms, at most \p maxcount */
+    int SourceCount(const int maxcount = INT_MAX) const {
+        int n = sourceviews.empty() ? HostSrc.size() : std::min(sourceviews.size(), HostSrc.size());
+        return std::min(std::min(std::max((int)numberimages, 1), n), maxcount); }
+
+    // plane depths used by planesweep and custom plane depths
+    std::vector<float> planes;
+    std::vector<float> customplanes;
+
+    /** \brief Depthmap and best NCC values of single source view kept for re-aggregation */
+    struct SourceMaps
+    {
+        uint64_t lastused;                  ///< \a RunAlgorithm() call count at last use
+        float dmin, dmax;                   ///< depth range used for compression
+        std::vector<float> depth, ncc;      ///< uncompressed depthmap and best NCC values
+        std::vector<uint16_t> cdepth;       ///< compressed depthmap
+        std::vector<int16_t> cncc;          ///< compressed best NCC values
+    };
+
+    // cached plane induced homographies shared by all plane based algorithms
+    HomographyCache homographies;
+
+    // cached per source view results
+    bool cachesourcemaps = DEFAULT_CACHE_SOURCE_MAPS;
+    bool compresssourcemaps = false;
+    std::map<uint64_t, SourceMaps> sourcemaps;
+    uint64_t runcount = 0;
 
     // CUDA kernel parameters
     int maxThreadsPerBlock = MAX_THREADS_PER_BLOCK;
@@ -473,29 +1321,143 @@ protected:
     bool depthavailable = false;
     bool alternativemethod = false;
 
+    // incremented whenever depthmap is produced, keys state kept by CudaDenoiseUpdate()
+    uint64_t depthgeneration = 0;
+
     /**
     *  \brief Depthmap normalization function for easy representation as grayscale image
     *
     *  \param input  depthmap input
     *  \param output normalized depthmap output returned by reference
     *
-    *  \details Depthmap is scaled to range [0,255] from [znear,zfar]
+    *  \details Depthmap is scaled to range [0,255] from [znear,zfar], linearly in inverse depth when planes
+    *  are distributed in inverse depth
     */
     void ConvertDepthtoUChar(const CamImage<float> &input, CamImage<uchar> &output);
 
+    /**
+    *  \brief Calculate plane depths for planesweep
+    *
+    *  \param nimgs number of source views used by planesweep
+    *
+    *  \details Plane depths are stored in \a planes and are distributed according to \a planedistribution.
+    * \a UniformDisparity uses source views to find widest baseline, that is the largest pixel shift per unit of inverse depth.
+    */
+    void CalculatePlaneDepths(const int nimgs);
+
+    /**
+    *  \brief Calculate key identifying planesweep result of single source view
+    *
+    *  \param index index of source view image in \a std::vector
+    *  \return Hash of reference and source view generations, source view identity, camera matrices, plane depths
+    * and planesweep parameters
+    */
+    uint64_t SourceMapsKey(const unsigned int index) const;
+
+    /**
+    *  \brief Store depthmap and best NCC values of single source view in cache
+    *
+    *  \param key        key returned by \a SourceMapsKey()
+    *  \param devDepth   pointer to depthmap on the GPU
+    *  \param devbestNCC pointer to best NCC values on the GPU
+    *
+    *  \details Least recently used entry is removed when cache holds \a MAX_CACHED_SOURCE_MAPS entries
+    */
+    void StoreSourceMaps(const uint64_t key, const float * devDepth, const float * devbestNCC);
+
+    /**
+    *  \brief Restore cached depthmap and best NCC values of single source view
+    *
+    *  \param key        key returned by \a SourceMapsKey()
+    *  \param devDepth   pointer to depthmap on the GPU to restore to
+    *  \param devbestNCC pointer to best NCC values on the GPU to restore to
+    *  \return Success if cache contains entry with given key
+    */
+    bool RestoreSourceMaps(const uint64_t key, float * devDepth, float * devbestNCC);
+
+    /**
+    *  \brief Sweep source views using given matching cost policy
+    *
+    *  \param globDepth pointer to sum of depthmaps on the GPU
+    *  \param globN     pointer to depthmap summation count on the GPU
+    *  \param globConf  pointer to sum of depth confidence on the GPU, \a nullptr if not needed
+    *  \param Ref       pointer to reference intensity image on the GPU
+    *  \param nimgs     number of source views
+    *
+    *  \tparam Cost     matching cost policy, see matching_cost.h
+    */
+    template<class Cost>
+    void SweepSources(float * globDepth, float * globN, float * globConf, const float * Ref, const int nimgs);
+
+    /**
+    *  \brief Sweep best source views with all planes and verify best depth candidates with remaining ones
+    *
+    *  \param globDepth pointer to sum of depthmaps on the GPU
+    *  \param globN     pointer to depthmap summation count on the GPU
+    *  \param Ref       pointer to reference intensity image on the GPU
+    *  \param nimgs     number of source views
+    *
+    *  \details Uses ZNCC matching cost, see \a setCandidatePruning()
+    */
+    void SweepPruned(float * globDepth, float * globN, const float * Ref, const int nimgs);
+
+    /**
+    *  \brief Calculate cost volume using given matching cost policy
+    *
+    *  \param sink      consumer of cost volume slabs
+    *  \param encoding  cost volume encoding
+    *  \param slabsize  number of planes in single slab
+    *
+    *  \tparam Cost     matching cost policy, see matching_cost.h
+    */
+    template<class Cost>
+    void CostVolumeSweep(const CostVolumeSink & sink, CostVolumeEncoding encoding, unsigned int slabsize);
+
+    /**
+    *  \brief Run TVL1 denoising iterations on GPU (all pointers point to memory on the GPU)
+    *
+    *  \param u         primal variable, initial values are overwritten with denoised values
+    *  \param R         dual variable \f$r\f$
+    *  \param Px        dual variable \f$p_x\f$
+    *  \param Py        dual variable \f$p_y\f$
+    *  \param rawInput  normalized input scaled by \f$-\sigma\f$
+    *  \param T11       anisotropic diffusion tensor element (1, 1)
+    *  \param T12       anisotropic diffusion tensor element (1, 2)
+    *  \param T21       anisotropic diffusion tensor element (2, 1)
+    *  \param T22       anisotropic diffusion tensor element (2, 2)
+    *  \param niters    number of iterations
+    *  \param lambda    TVL1 parameter \f$\lambda\f$
+    *  \param tau       TVL1 parameter \f$\tau\f$
+    *  \param sigma     TVL1 parameter \f$\sigma\f$
+    *  \param theta     TVL1 parameter \f$\theta\f$
+    *  \param coldstart dual variables are zero and first iteration uses step \f$1+\sigma\f$
+    *  \param w         image width
+    *  \param h         image height
+    *  \return Number of iterations run, less than \p niters if stopped by \a setDenoiseTolerance()
+    */
+    unsigned int TVL1Iterations(float * u, float * R, float * Px, float * Py, const float * rawInput,
+                                const float * T11, const float * T12, const float * T21, const float * T22,
+                                const unsigned int niters, const double lambda, const double tau,
+                                const double sigma, const double theta, const bool coldstart,
+                                const int w, const int h);
+
     /**
     *  \brief Single planesweep thread operating on single source view (all pointers point to memory on the GPU):
     *
     *  \param globDepth pointer to sum of depthmaps
     *  \param globN     pointer to depthmap summation count
+    *  \param globConf  pointer to sum of depth confidence, \a nullptr if not needed
     *  \param Ref       pointer to reference intensity image
-    *  \param Refmean  pointer to reference windowed means image
-    *  \param Refstd    pointer to reference windowed STD image
+    *  \param cost      matching cost policy holding reference image data
+    *  \param guide     guided filter used to aggregate similarity slices, \a nullptr if disabled
     *  \param index     index of source view image in \a std::vector
     *
+    *  \tparam Cost     matching cost policy, see matching_cost.h
+    *
     *  \details Multithreading does not increase performance
     */
-    void PlaneSweepThread(float * globDepth, float * globN, const float * Ref, const float * Refmean, const float * Refstd,
+    template<class Cost>
+    void PlaneSweepThread(float * globDepth, float * globN, float * globConf, const float * Ref, Cost & cost, GuidedFilter * guide,
                           const unsigned int &index);
 
 private:
@@ -0,0 +1,100 @@
+/**
+ *  \file rectified_stereo.h
+ *  \brief Header file containing RectifiedStereo class implementation
+ */
+#ifndef RECTIFIED_STEREO_H
+#define RECTIFIED_STEREO_H
+
+#include "defines.h"
+#include <vector>
+
+/** \addtogroup planesweep
+* @{
+*/
+
+/**
+*  \brief Class that implements ZNCC disparity search for rectified stereo pairs on CPU
+*
+*  \details For rectified pairs plane homographies reduce to horizontal shifts, so warping is replaced by indexing.
+* Window means and standard deviations of both images are calculated once, only the window sum of products
+* depends on disparity. It is calculated with running column and row sums, so each disparity costs O(1) per pixel
+* independently of window size. Image rows are split into bands processed by separate threads.
+*/
+class RectifiedStereo
+{
+public:
+    /**
+    *  \brief Constructor
+    *
+    *  \param width   image width
+    *  \param height  image height
+    */
+    RectifiedStereo(unsigned int width, unsigned int height);
+
+    /**
+    *  \brief Set matching window size
+    *
+    *  \param winsize window size, odd number
+    */
+    void setWindowSize(unsigned int winsize){ r = winsize / 2; }
+
+    /**
+    *  \brief Set matching thresholds
+    *
+    *  \param stdthresh windows with STD below threshold are not matched
+    *  \param nccthresh matches with NCC below threshold are rejected
+    */
+    void setThresholds(float stdthresh, float nccthresh){ this->stdthresh = stdthresh; this->nccthresh = nccthresh; }
+
+    /**
+    *  \brief Calculate depthmap
+    *
+    *  \param depthmap  output depthmap of \a width * \a height values
+    *  \param ref       reference image
+    *  \param src       source image
+    *  \param dmin      smallest disparity
+    *  \param dmax      largest disparity
+    *  \param direction 1 if source pixel of disparity \a d is \a x + \a d, -1 if it is \a x - \a d
+    *  \param fb        focal length times baseline, depth is \a fb / disparity
+    *
+    *  \details Pixels with no valid match are set to \a QNAN. Disparity is refined by parabola fit.
+    */
+    void compute(float * depthmap, const float * ref, const float * src, int dmin, int dmax, int direction, float fb);
+
+protected:
+
+    /**
+    *  \brief Calculate window means and standard deviations
+    *
+    *  \param mean output window means
+    *  \param std  output window standard deviations, 0 where window does not fit in image
+    *  \param img  input image
+    */
+    void windowStats(float * mean, float * std, const float * img) const;
+
+    /**
+    *  \brief Sweep all disparities over band of rows
+    *
+    *  \param y0        first row of band
+    *  \param y1        row after last row of band
+    *  \param ref       reference image
+    *  \param src       source image
+    *  \param dmin      smallest disparity
+    *  \param dmax      largest disparity
+    *  \param direction disparity direction
+    */
+    void sweepRows(int y0, int y1, const float * ref, const float * src, int dmin, int dmax, int direction);
+
+    unsigned int w, h;
+    int r = DEFAULT_WINDOW_SIZE / 2;
+    float stdthresh = DEFAULT_STD_THRESHOLD;
+    float nccthresh = DEFAULT_NCC_THRESHOLD;
+
+    std::vector<float> refmean, refstd, srcmean, srcstd;    // window statistics
+    std::vector<float> best, below, above, prev;            // best NCC, its neighbours and last NCC of each pixel
+    std::vector<int> bestd, prevd;                          // disparities of best and last NCC
+};
+
+/** @} */ // group planesweep
+
+#endif // RECTIFIED_STEREO_H
@@ -0,0 +1,113 @@
+/**
+ *  \file sgm.h
+ *  \brief Header file containing SGM class implementation
+ */
+#ifndef SGM_H
+#define SGM_H
+
+#include "defines.h"
+#include "planesweep.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+/** \addtogroup planesweep
+* @{
+*/
+
+/**
+*  \brief Class that implements semi-global matching aggregation over 8 bit planesweep cost volume on CPU
+*
+*  \details Cost volume is stored pixel-major, so that costs of all planes of single pixel are contiguous and
+* path recursions are vectorized along depth. Paths are aggregated in two scanline passes, forward pass
+* (left to right, top to bottom and both downward diagonals) and backward pass (the opposite directions),
+* each needing only two rows of path costs per path, so path buffers stay small even for 1080p images with
+* 256 planes. Aggregated costs are stored as 16 bit values. Cost volume of whole image is held in memory, so
+* \a PlaneSweep::RunSGM() uses one object per strip of rows to bound memory.
+*/
+class SGM
+{
+public:
+    /**
+    *  \brief Constructor
+    *
+    *  \param width   image width
+    *  \param height  image height
+    *  \param nplanes number of planes
+    */
+    SGM(unsigned int width, unsigned int height, unsigned int nplanes);
+
+    /**
+    *  \brief Get cost volume sink that stores plane-major 8 bit slabs produced by \a PlaneSweep::RunCostVolume()
+    *
+    *  \return Cost volume sink, valid for the lifetime of this object
+    *
+    *  \details Slabs are transposed to pixel-major layout in tiles of \a SGM_TILE_SIZE pixels
+    */
+    CostVolumeSink sink();
+
+    /**
+    *  \brief Set smoothness penalties
+    *
+    *  \param p1 penalty for depth change of one plane
+    *  \param p2 penalty for larger depth changes
+    */
+    void setPenalties(uint16_t p1, uint16_t p2){ P1 = p1; P2 = std::max(p1, std::min(p2, (uint16_t)SGM_MAX_P2)); }
+
+    /**
+    *  \brief Set number of aggregation paths
+    *
+    *  \param n number of paths, 4 (horizontal and vertical) or 8 (including diagonals)
+    */
+    void setPaths(unsigned int n){ paths = n < 8 ? 4 : 8; }
+
+    /**
+    *  \brief Aggregate costs along all paths
+    */
+    void aggregate();
+
+    /**
+    *  \brief Select plane with lowest aggregated cost for each pixel
+    *
+    *  \param depthmap output depthmap of \a width * \a height values
+    *  \param planes   plane depths
+    *
+    *  \details Pixels with no valid cost are set to \a QNAN. Depth is refined between planes by parabola fit.
+    */
+    void winnerTakesAll(float * depthmap, const std::vector<float> & planes) const;
+
+    /** \brief Get pointer to pixel-major 8 bit cost volume */
+    uint8_t * costs(){ return cost.data(); }
+
+protected:
+
+    /**
+    *  \brief Aggregate single scanline pass
+    *
+    *  \param forward forward pass if true, backward pass otherwise
+    */
+    void aggregatePass(bool forward);
+
+    /**
+    *  \brief Path cost recursion for single pixel
+    *
+    *  \param Lr   output path costs of current pixel
+    *  \param prev path costs of previous pixel on path, \a nullptr at image border
+    *  \param C    matching costs of current pixel
+    *  \param S    aggregated costs of current pixel to add path costs to
+    */
+    void pathCost(uint16_t * __restrict Lr, const uint16_t * __restrict prev, const uint8_t * __restrict C,
+                  uint16_t * __restrict S) const;
+
+    unsigned int w, h, d;
+    unsigned int paths = DEFAULT_SGM_PATHS;
+    uint16_t P1 = DEFAULT_SGM_P1;
+    uint16_t P2 = DEFAULT_SGM_P2;
+
+    std::vector<uint8_t> cost;      // pixel-major matching costs
+    std::vector<uint16_t> sum;      // pixel-major aggregated costs
+};
+
+/** @} */ // group planesweep
+
+#endif // SGM_H
@@ -0,0 +1,196 @@
+/**
+ *  \file tvl1.h
+ *  \brief Header file containing TVL1Solver and TVL1BatchSolver class implementations
+ */
+#ifndef TVL1_H
+#define TVL1_H
+
+#include "defines.h"
+#include <vector>
+
+/** \addtogroup planesweep
+* @{
+*/
+
+/**
+*  \brief Class that implements tensor weighed TVL1 denoising on CPU
+*
+*  \details Iterations are the same as in \a PlaneSweep::CudaDenoise(): dual update of \f$p\f$ with
+* \a denoising_TVL1_calculateP_tensor_weighed() followed by \a denoising_TVL1_update(). Both updates are fused into
+* one pass over image rows. Dual row \a y only needs primal rows \a y and \a y + 1 from previous iteration and primal
+* row \a y needs dual rows \a y - 1 and \a y from current one, so primal row is updated right behind dual row and
+* each row is read from memory once per iteration. Rows are split into bands processed by separate threads. Last row of
+* each band reads saved copy of next band's first row and first row of each band is updated after all bands have
+* finished their dual rows, so bands give the same result as single pass over the whole image. Row loops have no
+* branches and are vectorized by the compiler.
+*/
+class TVL1Solver
+{
+public:
+    /**
+    *  \brief Constructor
+    *
+    *  \param width   image width
+    *  \param height  image height
+    */
+    TVL1Solver(unsigned int width, unsigned int height);
+
+    /**
+    *  \brief Calculate anisotropic diffusion tensor
+    *
+    *  \param img   guide image, intensities in range [0,1]
+    *  \param beta  TVL1 parameter \f$\beta\f$
+    *  \param gamma TVL1 parameter \f$\gamma\f$
+    *
+    *  \details Same as \a Anisotropic_diffusion_tensor(), tensor is identity if this function is not called.
+    */
+    void setTensor(const float * img, float beta, float gamma);
+
+    /**
+    *  \brief Run denoising iterations
+    *
+    *  \param u      primal variable \f$u\f$, initial values are overwritten with denoised values
+    *  \param origin original input normalized and scaled by \f$-\sigma\f$
+    *  \param niters number of iterations
+    *  \param lambda TVL1 parameter \f$\lambda\f$
+    *  \param tau    TVL1 parameter \f$\tau\f$
+    *  \param sigma  TVL1 parameter \f$\sigma\f$
+    *  \param theta  TVL1 parameter \f$\theta\f$
+    *
+    *  \details Dual variables are reset to 0 before first iteration.
+    */
+    void solve(float * u, const float * origin, unsigned int niters, float lambda, float tau, float sigma, float theta);
+
+protected:
+
+    /**
+    *  \brief Update dual variable \f$p\f$ of single row
+    *
+    *  \param y     row index
+    *  \param u     primal row \a y
+    *  \param un    primal row \a y + 1, row \a y for last row
+    *  \param sigma TVL1 parameter \f$\sigma\f$
+    */
+    void dualRow(int y, const float * u, const float * un, float sigma);
+
+    /**
+    *  \brief Update dual variable \f$r\f$ and primal variable \f$u\f$ of single row
+    *
+    *  \param y      row index
+    *  \param u      primal row \a y
+    *  \param origin original input row \a y
+    *  \param lambda TVL1 parameter \f$\lambda\f$
+    *  \param tau    TVL1 parameter \f$\tau\f$
+    *  \param sigma  TVL1 parameter \f$\sigma\f$
+    *  \param theta  TVL1 parameter \f$\theta\f$
+    */
+    void primalRow(int y, float * u, const float * origin, float lambda, float tau, float sigma, float theta);
+
+    unsigned int w, h;
+
+    std::vector<float> T11, T12, T21, T22;  // anisotropic diffusion tensor
+    std::vector<float> Px, Py, R;           // dual variables
+};
+
+/**
+*  \brief Class that implements tensor weighed TVL1 denoising of many same size depthmaps on CPU
+*
+*  \details Iterations are the same as in \a TVL1Solver, but \a lanes depthmaps are interleaved pixel by pixel, so
+* values of one pixel in all depthmaps are stored next to each other. Each lane can have its own TVL1 parameters, so
+* the same depthmap can also be solved with different parameter sets. Innermost loops run over lanes with unit stride
+* and no branches, so each vector lane holds a different depthmap and no shuffles are needed. Anisotropic diffusion
+* tensor is shared by all lanes and calculated once for the whole batch.
+*/
+class TVL1BatchSolver
+{
+public:
+    /**
+    *  \brief Constructor
+    *
+    *  \param width   image width
+    *  \param height  image height
+    *  \param lanes   number of interleaved depthmaps
+    */
+    TVL1BatchSolver(unsigned int width, unsigned int height, unsigned int lanes);
+
+    /**
+    *  \brief Calculate anisotropic diffusion tensor shared by all lanes
+    *
+    *  \param img   guide image, intensities in range [0,1]
+    *  \param beta  TVL1 parameter \f$\beta\f$
+    *  \param gamma TVL1 parameter \f$\gamma\f$
+    *
+    *  \details Same as \a TVL1Solver::setTensor()
+    */
+    void setTensor(const float * img, float beta, float gamma);
+
+    /**
+    *  \brief Interleave depthmaps into batch layout
+    *
+    *  \param output interleaved output of \a width * \a height * \a lanes values
+    *  \param inputs pointers to \a lanes input images of \a width * \a height values
+    */
+    void interleave(float * output, const float * const * inputs) const;
+
+    /**
+    *  \brief Split batch layout into separate depthmaps
+    *
+    *  \param outputs pointers to \a lanes output images of \a width * \a height values
+    *  \param input   interleaved input
+    */
+    void deinterleave(float * const * outputs, const float * input) const;
+
+    /**
+    *  \brief Run denoising iterations on all lanes
+    *
+    *  \param u      interleaved primal variables, initial values are overwritten with denoised values
+    *  \param origin interleaved original inputs normalized and scaled by \f$-\sigma\f$ of their lane
+    *  \param niters number of iterations
+    *  \param lambda TVL1 parameter \f$\lambda\f$ of each lane
+    *  \param tau    TVL1 parameter \f$\tau\f$ of each lane
+    *  \param sigma  TVL1 parameter \f$\sigma\f$ of each lane
+    *  \param theta  TVL1 parameter \f$\theta\f$ of each lane
+    *
+    *  \details Dual variables are reset to 0 before first iteration.
+    */
+    void solve(float * u, const float * origin, unsigned int niters, const float * lambda, const float * tau,
+               const float * sigma, const float * theta);
+
+    /** \brief Get number of interleaved depthmaps */
+    unsigned int lanes() const { return n; }
+
+protected:
+
+    /**
+    *  \brief Update dual variable \f$p\f$ of single row in all lanes
+    *
+    *  \param y     row index
+    *  \param u     interleaved primal row \a y
+    *  \param un    interleaved primal row \a y + 1, row \a y for last row
+    *  \param sigma TVL1 parameter \f$\sigma\f$ of each lane
+    */
+    void dualRow(int y, const float * u, const float * un, const float * sigma);
+
+    /**
+    *  \brief Update dual variable \f$r\f$ and primal variable \f$u\f$ of single row in all lanes
+    *
+    *  \param y      row index
+    *  \param u      interleaved primal row \a y
+    *  \param origin interleaved original input row \a y
+    *  \param lambda TVL1 parameter \f$\lambda\f$ of each lane
+    *  \param tau    TVL1 parameter \f$\tau\f$ of each lane
+    *  \param sigma  TVL1 parameter \f$\sigma\f$ of each lane
+    *  \param theta  TVL1 parameter \f$\theta\f$ of each lane
+    */
+    void primalRow(int y, float * u, const float * origin, const float * lambda, const float * tau,
+                   const float * sigma, const float * theta);
+
+    unsigned int w, h, n;
+
+    std::vector<float> T11, T12, T21, T22;  // anisotropic diffusion tensor shared by all lanes
+    std::vector<float> Px, Py, R;           // interleaved dual variables
+};
+
+/** @} */ // group planesweep
+
+#endif // TVL1_H
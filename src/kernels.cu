@@ -1,5 +1,7 @@
 #include <kernels.cu.h>
 #include <helper_structs.h>
+#include <defines.h>
+#include <cuda_fp16.h>
 
 __global__ void bilinear_interpolation_kernel_GPU(float * __restrict__ d_result, const float * __restrict__ d_data,
                                                   const float * __restrict__ d_xout, const float * __restrict__ d_yout,
@@ -81,6 +83,316 @@ __global__ void update_arrays_kernel(float * __restrict__ d_depthmap, float * __
     }
 }
 
+__global__ void update_arrays_subplane_kernel(float * __restrict__ d_depthmap, float * __restrict__ d_bestncc,
+                                              float * __restrict__ d_bestindex, float * __restrict__ d_prevncc,
+                                              float * __restrict__ d_nccbelow, float * __restrict__ d_nccabove,
+                                              const float * __restrict__ d_currentncc, const float current_depth,
+                                              const int current_index,
+                                              const int width, const int height, const float QNaN)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const float ncc = d_currentncc[ind];
+
+        // Update if better correspondance was found, NCC of plane in front is already known,
+        // NCC of plane behind is filled in at next plane
+        if (ncc > d_bestncc[ind]){
+            d_bestncc[ind] = ncc;
+            d_depthmap[ind] = current_depth;
+            d_bestindex[ind] = current_index;
+            d_nccbelow[ind] = current_index > 0 ? d_prevncc[ind] : QNaN;
+            d_nccabove[ind] = QNaN;
+        }
+        else if (d_bestindex[ind] == current_index - 1) d_nccabove[ind] = ncc;
+
+        d_prevncc[ind] = ncc;
+    }
+}
+
+__global__ void refine_depth_subplane_kernel(float * __restrict__ d_depthmap, const float * __restrict__ d_bestncc,
+                                             const float * __restrict__ d_bestindex,
+                                             const float * __restrict__ d_nccbelow, const float * __restrict__ d_nccabove,
+                                             const float * __restrict__ d_planes, const int nplanes,
+                                             const bool equiangular,
+                                             const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const int i = d_bestindex[ind];
+
+        // Peaks at first or last plane can not be refined
+        if ((i <= 0) || (i >= nplanes - 1)) return;
+
+        const float cm = d_nccbelow[ind], c0 = d_bestncc[ind], cp = d_nccabove[ind];
+        if ((cm != cm) || (cp != cp)) return;
+
+        // Offset of the peak from best plane in plane index units
+        float offset;
+        if (equiangular){
+            const float denom = 2.f * (c0 - fminf(cm, cp));
+            if (denom <= 0.f) return;
+            offset = (cp - cm) / denom;
+        }
+        else {
+            const float denom = cm - 2.f * c0 + cp;
+            if (denom >= 0.f) return;
+            offset = .5f * (cm - cp) / denom;
+        }
+        offset = fminf(fmaxf(offset, -.5f), .5f);
+
+        // Interpolate depth between neighbouring planes
+        if (offset > 0.f) d_depthmap[ind] = d_planes[i] + offset * (d_planes[i + 1] - d_planes[i]);
+        else d_depthmap[ind] = d_planes[i] + offset * (d_planes[i] - d_planes[i - 1]);
+    }
+}
+
+__global__ void element_difference_kernel(float * __restrict__ d_output, const float * __restrict__ d_input1,
+                                          const float * __restrict__ d_input2, const bool absolute,
+                                          const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const float diff = d_input1[ind] - d_input2[ind];
+        d_output[ind] = absolute ? fabsf(diff) : diff;
+    }
+}
+
+__global__ void census_transform_kernel(unsigned int * __restrict__ d_output, const float * __restrict__ d_input,
+                                        const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const float center = d_input[ind];
+        const int n = CENSUS_WINDOW_SIZE / 2;
+        unsigned int bits = 0;
+        int kx, ky;
+
+        // Set bit for every neighbour darker than center pixel, borders are mirrored
+        for (int j = -n; j <= n; j++){
+            ky = ind_y + j;
+            if (ky < 0) ky = -ky;
+            if (ky > height - 1) ky = 2 * (height - 1) - ky;
+            for (int i = -n; i <= n; i++){
+                if ((i == 0) && (j == 0)) continue;
+                kx = ind_x + i;
+                if (kx < 0) kx = -kx;
+                if (kx > width - 1) kx = 2 * (width - 1) - kx;
+                bits = (bits << 1) | (d_input[ky * width + kx] < center);
+            }
+        }
+        d_output[ind] = bits;
+    }
+}
+
+__global__ void hamming_distance_kernel(float * __restrict__ d_output, const unsigned int * __restrict__ d_input1,
+                                        const unsigned int * __restrict__ d_input2,
+                                        const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        d_output[ind] = __popc(d_input1[ind] ^ d_input2[ind]);
+    }
+}
+
+__global__ void cost_to_similarity_kernel(float * __restrict__ d_output, const float * __restrict__ d_cost,
+                                          const float scale, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        d_output[ind] = fmaxf(1.f - scale * d_cost[ind], -1.f);
+    }
+}
+
+__global__ void element_accumulate_kernel(float * __restrict__ d_output, const float * __restrict__ d_input,
+                                          const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        d_output[ind] += d_input[ind];
+    }
+}
+
+__global__ void encode_cost_uchar_kernel(unsigned char * __restrict__ d_output, const float * __restrict__ d_similarity,
+                                         const float scale, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const float cost = 1.f - scale * d_similarity[ind];
+
+        // Cost range [0,2] is mapped to [0,255], QNAN is mapped to 255
+        if (cost == cost) d_output[ind] = (unsigned char)(fminf(fmaxf(cost * UCHAR_MAX / 2.f + .5f, 0.f), UCHAR_MAX));
+        else d_output[ind] = UCHAR_MAX;
+    }
+}
+
+__global__ void encode_cost_half_kernel(unsigned short * __restrict__ d_output, const float * __restrict__ d_similarity,
+                                        const float scale, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        d_output[ind] = __half_as_ushort(__float2half_rn(1.f - scale * d_similarity[ind]));
+    }
+}
+
+__device__ inline
+float box_filter_scan(float * __restrict__ s, const float value)
+{
+    // Inclusive scan of values of threads in the same block row, s holds blockDim.x values of the row
+    s[threadIdx.x] = value;
+    __syncthreads();
+    for (int o = 1; o < (int)blockDim.x; o *= 2){
+        const float prev = (int)threadIdx.x >= o ? s[threadIdx.x - o] : 0.f;
+        __syncthreads();
+        s[threadIdx.x] += prev;
+        __syncthreads();
+    }
+    return s[threadIdx.x];
+}
+
+__global__ void box_filter_row_kernel(float * __restrict__ d_output, const float * __restrict__ d_input,
+                                      const int radius, const int width, const int height)
+{
+    // Each block row filters single image row, all threads take part in scans, so none of them returns early
+    extern __shared__ float scan[];
+    float * s = scan + threadIdx.y * blockDim.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+    const bool inside = ind_y < height;
+    const float * row = d_input + ind_y * width;
+
+    // Window sum before first pixel is sum of first radius pixels
+    float part = 0.f;
+    if (inside)
+        for (int x = threadIdx.x; x < min(radius, width); x += blockDim.x) part += row[x];
+    box_filter_scan(s, part);
+    float sum = s[blockDim.x - 1];
+    __syncthreads();
+
+    // Window sum changes by pixel entering and pixel leaving the window, changes of consecutive pixels are scanned
+    for (int x0 = 0; x0 < width; x0 += blockDim.x){
+        const int x = x0 + threadIdx.x;
+        float change = 0.f;
+        if (inside && (x < width)){
+            if (x + radius < width) change += row[x + radius];
+            if (x - radius - 1 >= 0) change -= row[x - radius - 1];
+        }
+
+        const float window = sum + box_filter_scan(s, change);
+        if (inside && (x < width))
+            d_output[ind_y * width + x] = window / (float)(min(x + radius, width - 1) - max(x - radius, 0) + 1);
+        sum += s[blockDim.x - 1];
+        __syncthreads();
+    }
+}
+
+__global__ void box_filter_column_totals_kernel(float * __restrict__ d_total, const float * __restrict__ d_input,
+                                                const int radius, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int y0 = (threadIdx.y + blockDim.y * blockIdx.y) * BOX_FILTER_SEGMENT;
+
+    if ((ind_x < width) && (y0 < height)) {
+        // Total window sum change over segment is stored in first row of the segment
+        float total = 0.f;
+        for (int y = y0; y < min(y0 + BOX_FILTER_SEGMENT, height); y++){
+            if (y + radius < height) total += d_input[(y + radius) * width + ind_x];
+            if (y - radius - 1 >= 0) total -= d_input[(y - radius - 1) * width + ind_x];
+        }
+        d_total[y0 * width + ind_x] = total;
+    }
+}
+
+__global__ void box_filter_column_starts_kernel(float * __restrict__ d_total, const float * __restrict__ d_input,
+                                                const int radius, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+
+    if (ind_x < width) {
+        // Window sum before first row is sum of first radius rows
+        float sum = 0.f;
+        for (int y = 0; y < min(radius, height); y++) sum += d_input[y * width + ind_x];
+
+        // Segment totals are replaced by window sums before the first row of their segment
+        for (int y0 = 0; y0 < height; y0 += BOX_FILTER_SEGMENT){
+            const float total = d_total[y0 * width + ind_x];
+            d_total[y0 * width + ind_x] = sum;
+            sum += total;
+        }
+    }
+}
+
+__global__ void box_filter_column_kernel(float * __restrict__ d_output, const float * __restrict__ d_input,
+                                         const int radius, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int y0 = (threadIdx.y + blockDim.y * blockIdx.y) * BOX_FILTER_SEGMENT;
+
+    if ((ind_x < width) && (y0 < height)) {
+        // Running sum over segment starts from window sum stored by box_filter_column_starts_kernel()
+        float sum = d_output[y0 * width + ind_x];
+        for (int y = y0; y < min(y0 + BOX_FILTER_SEGMENT, height); y++){
+            if (y + radius < height) sum += d_input[(y + radius) * width + ind_x];
+            if (y - radius - 1 >= 0) sum -= d_input[(y - radius - 1) * width + ind_x];
+            d_output[y * width + ind_x] = sum / (float)(min(y + radius, height - 1) - max(y - radius, 0) + 1);
+        }
+    }
+}
+
+__global__ void guided_filter_coefficients_kernel(float * __restrict__ d_a, float * __restrict__ d_b,
+                                                  const float * __restrict__ d_mean_p, const float * __restrict__ d_corr_Ip,
+                                                  const float * __restrict__ d_mean_I, const float * __restrict__ d_var_I,
+                                                  const float eps, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const float a = (d_corr_Ip[ind] - d_mean_I[ind] * d_mean_p[ind]) / (d_var_I[ind] + eps);
+        d_a[ind] = a;
+        d_b[ind] = d_mean_p[ind] - a * d_mean_I[ind];
+    }
+}
+
+__global__ void guided_filter_output_kernel(float * __restrict__ d_output, const float * __restrict__ d_mean_a,
+                                            const float * __restrict__ d_mean_b, const float * __restrict__ d_I,
+                                            const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        d_output[ind] = d_mean_a[ind] * d_I[ind] + d_mean_b[ind];
+    }
+}
+
 __global__ void sum_depthmap_NCC_kernel(float * __restrict__ d_depthmap_out, float * __restrict__ d_count,
                                         const float * __restrict__ d_depthmap, const float * __restrict__ d_ncc,
                                         const float nccthreshold,
@@ -100,6 +412,54 @@ __global__ void sum_depthmap_NCC_kernel(float * __restrict__ d_depthmap_out, flo
     }
 }
 
+__global__ void update_peak_kernel(float4 * __restrict__ d_peak, const float * __restrict__ d_currentncc,
+                                   const int current_index, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+
+        // Best NCC, best NCC away from its neighbouring planes, NCC sum and best plane index
+        float4 p = current_index == 0 ? make_float4(-2.f, -2.f, 0.f, -2.f) : d_peak[ind];
+        const float ncc = d_currentncc[ind];
+
+        if (ncc == ncc){
+            p.z += ncc;
+            if (ncc > p.x){
+                if (current_index - p.w > 1.f) p.y = fmaxf(p.y, p.x);
+                p.x = ncc;
+                p.w = current_index;
+            }
+            else if (current_index - p.w > 1.f) p.y = fmaxf(p.y, ncc);
+        }
+
+        d_peak[ind] = p;
+    }
+}
+
+__global__ void sum_confidence_kernel(float * __restrict__ d_confidence_out, const float4 * __restrict__ d_peak,
+                                      const float * __restrict__ d_ncc, const float nccthreshold, const int nplanes,
+                                      const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+
+        // Sum where depth is summed
+        if (d_ncc[ind] > nccthreshold){
+            const float4 p = d_peak[ind];
+            if (p.x <= 0.f) return;
+            const float ratio = 1.f - fmaxf(p.y, 0.f) / p.x;
+            const float sharpness = fminf(fmaxf(p.x - p.z / nplanes, 0.f), 1.f);
+            d_confidence_out[ind] += ratio * sharpness;
+        }
+    }
+}
+
 __global__ void calculate_STD_kernel(float * __restrict__ d_std, const float * __restrict__ d_mean,
                                      const float * __restrict__ d_mean_of_squares,
                                      const int width, const int height)
@@ -369,6 +729,57 @@ __global__ void denoising_TVL1_update_kernel(float * __restrict__ d_output, floa
     }
 }
 
+__global__ void denoising_TVL1_update_change_kernel(float * __restrict__ d_output, float * __restrict__ d_R,
+                                                    const float * d_Px, const float * d_Py, const float * __restrict__ d_origin,
+                                                    float * __restrict__ d_change,
+                                                    const float tau, const float theta, const float lambda, const float sigma,
+                                                    const int width, const int height)
+{
+    extern __shared__ float s_change[];
+
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+    const int tid = threadIdx.y * blockDim.x + threadIdx.x;
+    const int n = blockDim.x * blockDim.y;
+    float change = 0.f, norm = 0.f;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        double x_new;
+        int yp = ind_y - 1;
+        if (yp < 0) yp = 0;
+
+        d_R[ind] += d_origin[ind];
+        d_R[ind] += sigma * d_output[ind];
+        if (d_R[ind] > lambda) d_R[ind] = lambda;
+        if (d_R[ind] < -lambda) d_R[ind] = -lambda;
+
+        const float u = d_output[ind];
+        if (ind_x == 0) x_new = u + tau*(d_Py[ind] - d_Py[yp * width + ind_x]) - tau * d_R[ind];
+        else x_new = u + tau*(d_Px[ind] - d_Px[ind - 1] + d_Py[ind] - d_Py[yp * width + ind_x]) - tau * d_R[ind];
+        d_output[ind] = x_new + theta*(x_new - u);
+
+        change = (d_output[ind] - u) * (d_output[ind] - u);
+        norm = d_output[ind] * d_output[ind];
+    }
+
+    // Sum squared change and squared norm over block, then over grid
+    s_change[tid] = change;
+    s_change[n + tid] = norm;
+    __syncthreads();
+    for (int s = 1; s < n; s *= 2){
+        if ((tid % (2 * s) == 0) && (tid + s < n)){
+            s_change[tid] += s_change[tid + s];
+            s_change[n + tid] += s_change[n + tid + s];
+        }
+        __syncthreads();
+    }
+    if (tid == 0){
+        atomicAdd(d_change, s_change[0]);
+        atomicAdd(d_change + 1, s_change[n]);
+    }
+}
+
 __global__ void denoising_TVL1_update_tensor_weighed_kernel(float * __restrict__ d_output, float * __restrict__ d_R,
                                                             const float * d_Px, const float * d_Py, const float * __restrict__ d_origin,
                                                             const float * __restrict__ d_T11, const float * __restrict__ d_T12,
@@ -428,6 +839,75 @@ __global__ void compute3D_kernel(float * __restrict__ d_x, float * __restrict__
     }
 }
 
+__global__ void downsample_kernel(float * __restrict__ d_output, const float * __restrict__ d_input,
+                                  const int inwidth, const int inheight, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int x = 2 * ind_x, y = 2 * ind_y;
+        const int xn = min(x + 1, inwidth - 1), yn = min(y + 1, inheight - 1);
+        d_output[ind_y * width + ind_x] = .25f * (d_input[y * inwidth + x] + d_input[y * inwidth + xn] +
+                                                  d_input[yn * inwidth + x] + d_input[yn * inwidth + xn]);
+    }
+}
+
+__global__ void upsample_kernel(float * __restrict__ d_output, const float * __restrict__ d_input,
+                                const int inwidth, const int inheight, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        // Pixel centers of both grids are aligned
+        const float fx = fminf(fmaxf((ind_x + .5f) * inwidth / width - .5f, 0.f), inwidth - 1);
+        const float fy = fminf(fmaxf((ind_y + .5f) * inheight / height - .5f, 0.f), inheight - 1);
+        const int x = fx, y = fy;
+        const int xn = min(x + 1, inwidth - 1), yn = min(y + 1, inheight - 1);
+        const float ax = fx - x, ay = fy - y;
+        d_output[ind_y * width + ind_x] = (1.f - ay) * ((1.f - ax) * d_input[y * inwidth + x] + ax * d_input[y * inwidth + xn]) +
+                                          ay * ((1.f - ax) * d_input[yn * inwidth + x] + ax * d_input[yn * inwidth + xn]);
+    }
+}
+
+__global__ void warp_mipmapped_kernel(float * __restrict__ d_result, const MipLevels src, const Matrix3D h,
+                                      const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    // Level is chosen from homography scale at tile center, so the whole block reads the same level
+    const float3 c = h * make_float3(blockDim.x * (blockIdx.x + .5f) + .5f, blockDim.y * (blockIdx.y + .5f) + .5f, 1);
+    int level = 0;
+    if (c.z > 0.f){
+        const float cx = c.x / c.z, cy = c.y / c.z;
+        const float2 du = make_float2(h.r[0].x - cx * h.r[2].x, h.r[1].x - cy * h.r[2].x) / c.z;
+        const float2 dv = make_float2(h.r[0].y - cx * h.r[2].y, h.r[1].y - cy * h.r[2].y) / c.z;
+        const float scale = sqrtf(fmaxf(dot(du, du), dot(dv, dv)));
+        if (scale > 1.f) level = min((int)floorf(log2f(scale)), src.levels - 1);
+    }
+
+    if ((ind_x < width) && (ind_y < height)) {
+        float3 x = h * make_float3(ind_x + 1, ind_y + 1, 1);
+        x = x / x.z - 1;
+
+        // Pixel centers of level l are 2^l pixels apart
+        const float s = 1.f / (1 << level);
+        const float xl = (x.x + .5f) * s - .5f, yl = (x.y + .5f) * s - .5f;
+        const int M1 = src.width[level], M2 = src.height[level];
+        const float * d_data = src.level[level];
+
+        const int ix = floorf(xl), iy = floorf(yl);
+        if ((ix < 0) || (iy < 0) || (iy + 1 > M2 - 1) || (ix + 1 > M1 - 1)) { d_result[ind_y * width + ind_x] = 0.f; return; }
+
+        const float a = xl - ix, b = yl - iy;
+        const float r1 = a * d_data[iy * M1 + ix + 1] + (1 - a) * d_data[iy * M1 + ix];
+        const float r2 = a * d_data[(iy + 1) * M1 + ix + 1] + (1 - a) * d_data[(iy + 1) * M1 + ix];
+        d_result[ind_y * width + ind_x] = b * r2 + (1 - b) * r1;
+    }
+}
+
 void transform_indexes(float * d_x, float *  d_y,
                        const Matrix3D h,
                        const int width, const int height, dim3 blocks, dim3 threads)
@@ -469,6 +949,144 @@ void update_arrays(float * d_depthmap, float * d_bestncc,
                                               width, height);
 }
 
+void update_arrays_subplane(float * d_depthmap, float * d_bestncc,
+                            float * d_bestindex, float * d_prevncc,
+                            float * d_nccbelow, float * d_nccabove,
+                            const float * d_currentncc, const float current_depth,
+                            const int current_index,
+                            const int width, const int height,
+                            dim3 blocks, dim3 threads)
+{
+    const float QNan = std::numeric_limits<float>::quiet_NaN();
+    update_arrays_subplane_kernel<<<blocks, threads>>>(d_depthmap, d_bestncc,
+                                                       d_bestindex, d_prevncc,
+                                                       d_nccbelow, d_nccabove,
+                                                       d_currentncc, current_depth,
+                                                       current_index,
+                                                       width, height, QNan);
+}
+
+void refine_depth_subplane(float * d_depthmap, const float * d_bestncc,
+                           const float * d_bestindex,
+                           const float * d_nccbelow, const float * d_nccabove,
+                           const float * d_planes, const int nplanes,
+                           const bool equiangular,
+                           const int width, const int height,
+                           dim3 blocks, dim3 threads)
+{
+    refine_depth_subplane_kernel<<<blocks, threads>>>(d_depthmap, d_bestncc,
+                                                      d_bestindex,
+                                                      d_nccbelow, d_nccabove,
+                                                      d_planes, nplanes,
+                                                      equiangular,
+                                                      width, height);
+}
+
+void element_difference(float * d_output, const float * d_input1,
+                        const float * d_input2, const bool absolute,
+                        const int width, const int height,
+                        dim3 blocks, dim3 threads)
+{
+    element_difference_kernel<<<blocks, threads>>>(d_output, d_input1, d_input2, absolute, width, height);
+}
+
+void census_transform(unsigned int * d_output, const float * d_input,
+                      const int width, const int height,
+                      dim3 blocks, dim3 threads)
+{
+    census_transform_kernel<<<blocks, threads>>>(d_output, d_input, width, height);
+}
+
+void hamming_distance(float * d_output, const unsigned int * d_input1,
+                      const unsigned int * d_input2,
+                      const int width, const int height,
+                      dim3 blocks, dim3 threads)
+{
+    hamming_distance_kernel<<<blocks, threads>>>(d_output, d_input1, d_input2, width, height);
+}
+
+void cost_to_similarity(float * d_output, const float * d_cost,
+                        const float scale, const int width, const int height,
+                        dim3 blocks, dim3 threads)
+{
+    cost_to_similarity_kernel<<<blocks, threads>>>(d_output, d_cost, scale, width, height);
+}
+
+void element_accumulate(float * d_output, const float * d_input,
+                        const int width, const int height,
+                        dim3 blocks, dim3 threads)
+{
+    element_accumulate_kernel<<<blocks, threads>>>(d_output, d_input, width, height);
+}
+
+void encode_cost_uchar(unsigned char * d_output, const float * d_similarity,
+                       const float scale, const int width, const int height,
+                       dim3 blocks, dim3 threads)
+{
+    encode_cost_uchar_kernel<<<blocks, threads>>>(d_output, d_similarity, scale, width, height);
+}
+
+void encode_cost_half(unsigned short * d_output, const float * d_similarity,
+                      const float scale, const int width, const int height,
+                      dim3 blocks, dim3 threads)
+{
+    encode_cost_half_kernel<<<blocks, threads>>>(d_output, d_similarity, scale, width, height);
+}
+
+void box_filter(float * d_output, float * d_temp, const float * d_input,
+                const int radius, const int width, const int height,
+                dim3 threads)
+{
+    // Row pass scans blocks of threads.x pixels in each of threads.y rows per block
+    dim3 rowblocks(1, (height + threads.y - 1) / threads.y);
+    box_filter_row_kernel<<<rowblocks, threads, threads.x * threads.y * sizeof(float)>>>(d_temp, d_input, radius,
+                                                                                        width, height);
+
+    // Column pass scans segments of BOX_FILTER_SEGMENT rows, segment start values are kept in output
+    const int segments = (height + BOX_FILTER_SEGMENT - 1) / BOX_FILTER_SEGMENT;
+    dim3 columnblocks((width + threads.x - 1) / threads.x, (segments + threads.y - 1) / threads.y);
+    box_filter_column_totals_kernel<<<columnblocks, threads>>>(d_output, d_temp, radius, width, height);
+    const int n = threads.x * threads.y;
+    box_filter_column_starts_kernel<<<(width + n - 1) / n, n>>>(d_output, d_temp, radius, width, height);
+    box_filter_column_kernel<<<columnblocks, threads>>>(d_output, d_temp, radius, width, height);
+}
+
+void guided_filter_coefficients(float * d_a, float * d_b,
+                                const float * d_mean_p, const float * d_corr_Ip,
+                                const float * d_mean_I, const float * d_var_I,
+                                const float eps, const int width, const int height,
+                                dim3 blocks, dim3 threads)
+{
+    guided_filter_coefficients_kernel<<<blocks, threads>>>(d_a, d_b, d_mean_p, d_corr_Ip, d_mean_I, d_var_I,
+                                                           eps, width, height);
+}
+
+void guided_filter_output(float * d_output, const float * d_mean_a,
+                          const float * d_mean_b, const float * d_I,
+                          const int width, const int height,
+                          dim3 blocks, dim3 threads)
+{
+    guided_filter_output_kernel<<<blocks, threads>>>(d_output, d_mean_a, d_mean_b, d_I, width, height);
+}
+
+void downsample(float * d_output, const float * d_input, const int inwidth, const int inheight,
+                const int width, const int height, dim3 blocks, dim3 threads)
+{
+    downsample_kernel<<<blocks, threads>>>(d_output, d_input, inwidth, inheight, width, height);
+}
+
+void upsample(float * d_output, const float * d_input, const int inwidth, const int inheight,
+              const int width, const int height, dim3 blocks, dim3 threads)
+{
+    upsample_kernel<<<blocks, threads>>>(d_output, d_input, inwidth, inheight, width, height);
+}
+
+void warp_mipmapped(float * d_result, const MipLevels & src, const Matrix3D h,
+                    const int width, const int height, dim3 blocks, dim3 threads)
+{
+    warp_mipmapped_kernel<<<blocks, threads>>>(d_result, src, h, width, height);
+}
+
 void sum_depthmap_NCC(float * d_depthmap_out, float * d_count,
                       const float * d_depthmap, const float * d_ncc,
                       const float nccthreshold,
@@ -481,6 +1099,20 @@ void sum_depthmap_NCC(float * d_depthmap_out, float * d_count,
                                                  width, height);
 }
 
+void update_peak(float4 * d_peak, const float * d_currentncc, const int current_index,
+                 const int width, const int height, dim3 blocks, dim3 threads)
+{
+    update_peak_kernel<<<blocks, threads>>>(d_peak, d_currentncc, current_index, width, height);
+}
+
+void sum_confidence(float * d_confidence_out, const float4 * d_peak, const float * d_ncc,
+                    const float nccthreshold, const int nplanes,
+                    const int width, const int height,
+                    dim3 blocks, dim3 threads)
+{
+    sum_confidence_kernel<<<blocks, threads>>>(d_confidence_out, d_peak, d_ncc, nccthreshold, nplanes, width, height);
+}
+
 void calculate_STD(float * d_std, const float * d_mean,
                    const float * d_mean_of_squares,
                    const int width, const int height,
@@ -586,6 +1218,16 @@ void denoising_TVL1_update(float * d_output, float * d_R,
                                                       tau, theta, lambda, sigma, width, height);
 }
 
+void denoising_TVL1_update_change(float * d_output, float * d_R,
+                                  const float * d_Px, const float * d_Py, const float * d_origin, float * d_change,
+                                  const float tau, const float theta, const float lambda, const float sigma,
+                                  const int width, const int height, dim3 blocks, dim3 threads)
+{
+    const size_t shared = 2 * threads.x * threads.y * sizeof(float);
+    denoising_TVL1_update_change_kernel<<<blocks, threads, shared>>>(d_output, d_R, d_Px, d_Py, d_origin, d_change,
+                                                                     tau, theta, lambda, sigma, width, height);
+}
+
 void denoising_TVL1_update_tensor_weighed(float * d_output, float * d_R,
                                           const float * d_Px, const float * d_Py, const float * d_origin,
                                           const float * d_T11, const float * d_T12, const float * d_T21, const float * d_T22,
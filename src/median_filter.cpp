@@ -0,0 +1,109 @@
+#include "median_filter.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <climits>
+
+void MedianFilter::filterRows(int y0, int y1, float *output, const float *input) const
+{
+    const int W = w, H = h, B = MEDIAN_FILTER_BINS, C = MEDIAN_FILTER_COARSE, F = B / C;
+    const float QNan = std::numeric_limits<float>::quiet_NaN();
+    const float inear = 1.f / znear, ifar = 1.f / zfar;
+
+    // Column histograms of window rows, fine and coarse level
+    std::vector<unsigned short> colfine(W * B, 0), colcoarse(W * C, 0);
+    auto updateRow = [&](int y, int sign){
+        for (int x = 0; x < W; x++){
+            const int b = bins[y * W + x];
+            if (b < 0) continue;
+            colfine[x * B + b] += sign;
+            colcoarse[x * C + b / F] += sign;
+        }
+    };
+    for (int y = std::max(y0 - r - 1, 0); y < std::min(y0 + r, H); y++) updateRow(y, 1);
+
+    std::vector<int> kfine(B);
+    int kcoarse[MEDIAN_FILTER_COARSE];
+    int stamp[MEDIAN_FILTER_COARSE];
+
+    for (int y = y0; y < y1; y++){
+        if (y + r < H) updateRow(y + r, 1);
+        if (y - r - 1 >= 0) updateRow(y - r - 1, -1);
+
+        // Fine levels of window histogram are out of date until median falls into them
+        std::fill(kcoarse, kcoarse + C, 0);
+        std::fill(stamp, stamp + C, INT_MIN / 2);
+        for (int c = 0; c < std::min(r, W); c++)
+            for (int b = 0; b < C; b++) kcoarse[b] += colcoarse[c * C + b];
+
+        for (int x = 0; x < W; x++){
+            const int i = y * W + x;
+            if (x + r < W) for (int b = 0; b < C; b++) kcoarse[b] += colcoarse[(x + r) * C + b];
+            if (x - r - 1 >= 0) for (int b = 0; b < C; b++) kcoarse[b] -= colcoarse[(x - r - 1) * C + b];
+
+            int total = 0;
+            for (int b = 0; b < C; b++) total += kcoarse[b];
+            if (total == 0){
+                output[i] = QNan;
+                continue;
+            }
+
+            // Find coarse level containing median
+            const int target = (total + 1) / 2;
+            int acc = 0, b = 0;
+            while (acc + kcoarse[b] < target) acc += kcoarse[b++];
+
+            // Bring its fine level up to current window, recalculate it if windows do not overlap
+            int * fine = kfine.data() + b * F;
+            const int s = stamp[b];
+            if (s < x - 2 * r){
+                std::fill(fine, fine + F, 0);
+                for (int c = std::max(x - r, 0); c <= std::min(x + r, W - 1); c++)
+                    for (int f = 0; f < F; f++) fine[f] += colfine[c * B + b * F + f];
+            }
+            else {
+                for (int c = std::max(s - r, 0); c <= std::min(x - r - 1, W - 1); c++)
+                    for (int f = 0; f < F; f++) fine[f] -= colfine[c * B + b * F + f];
+                for (int c = std::max(s + r + 1, 0); c <= std::min(x + r, W - 1); c++)
+                    for (int f = 0; f < F; f++) fine[f] += colfine[c * B + b * F + f];
+            }
+            stamp[b] = x;
+
+            int f = 0;
+            while (acc + fine[f] < target) acc += fine[f++];
+            const int median = b * F + f;
+
+            if (bins[i] == median) output[i] = input[i];
+            else {
+                const float t = (median + .5f) / B;
+                output[i] = inverse ? 1.f / (inear - t * (inear - ifar)) : znear + t * (zfar - znear);
+            }
+        }
+    }
+}
+
+void MedianFilter::compute(float *output, const float *input)
+{
+    const int W = w, H = h, B = MEDIAN_FILTER_BINS;
+    const float inear = 1.f / znear, ifar = 1.f / zfar;
+
+    // Quantize depth between near and far plane
+    for (int i = 0; i < W * H; i++){
+        const float d = input[i];
+        if (d != d){
+            bins[i] = -1;
+            continue;
+        }
+        const float t = inverse ? (inear - 1.f / std::max(d, znear)) / (inear - ifar) : (d - znear) / (zfar - znear);
+        bins[i] = std::min(std::max(int(t * B), 0), B - 1);
+    }
+
+    // Split rows into bands, one per thread
+    const int nthreads = std::max(1, std::min((int)std::thread::hardware_concurrency(), H));
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nthreads; t++){
+        const int y0 = H * t / nthreads, y1 = H * (t + 1) / nthreads;
+        workers.push_back(std::thread(&MedianFilter::filterRows, this, y0, y1, output, input));
+    }
+    for (auto & worker : workers) worker.join();
+}
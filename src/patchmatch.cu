@@ -0,0 +1,338 @@
+// Kernels for PatchMatch multi-view stereo:
+#include "patchmatch.cu.h"
+#include <helper_structs.h>
+#include "dev_functions.h"
+#include <limits>
+
+__device__ inline
+bool sample_bilinear(float & value, const float * __restrict__ d_data, const float x, const float y,
+                     const int width, const int height)
+{
+    const int ix = floorf(x), iy = floorf(y);
+    if ((ix < 0) || (iy < 0) || (ix + 1 > width - 1) || (iy + 1 > height - 1)) return false;
+    const float * p = d_data + iy * width + ix;
+    value = bilinterp(make_float2(p[0], p[1]), make_float2(p[width], p[width + 1]), make_float2(x - ix, y - iy));
+    return true;
+}
+
+__device__
+float patchmatch_ncc(const float * __restrict__ d_ref, const PatchMatchParams & params, const int x, const int y,
+                     const float4 plane, const int width, const int height)
+{
+    // Plane n^T X = c passing through the pixel at given depth, indexes are 1 based as in transform_indexes
+    const float3 n = make_float3(plane.x, plane.y, plane.z);
+    const float3 ray = params.invK * make_float3(x + 1, y + 1, 1);
+    const float c = plane.w * dot(n, ray);
+    if ((plane.w < params.znear) || (plane.w > params.zfar) || (c <= 0.f)) return -1.f;
+
+    const int r = params.winsize / 2;
+    float total = 0.f;
+    int valid = 0;
+
+    for (int s = 0; s < params.nsrc; s++){
+        // Homography H = K (R + t n^T / c) K^-1
+        const float3 t = params.trel[s] / c;
+        const Matrix3D H = params.K * (params.Rrel[s] + Matrix3D(t.x * n, t.y * n, t.z * n)) * params.invK;
+
+        float sr = 0.f, ss = 0.f, srr = 0.f, sss = 0.f, srs = 0.f;
+        int count = 0;
+        for (int j = -r; j <= r; j++){
+            const int ry = min(max(y + j, 0), height - 1);
+            for (int i = -r; i <= r; i++){
+                const int rx = min(max(x + i, 0), width - 1);
+                const float3 q = H * make_float3(rx + 1, ry + 1, 1);
+                if (q.z <= 0.f) continue;
+                float vs;
+                if (!sample_bilinear(vs, params.src[s], q.x / q.z - 1, q.y / q.z - 1,
+                                     params.srcwidth[s], params.srcheight[s])) continue;
+                const float vr = d_ref[ry * width + rx];
+                sr += vr; ss += vs; srr += vr * vr; sss += vs * vs; srs += vr * vs;
+                count++;
+            }
+        }
+
+        // Source view does not see most of the window
+        if (2 * count < params.winsize * params.winsize) continue;
+
+        const float inv = 1.f / count;
+        const float mr = sr * inv, ms = ss * inv;
+        const float vr = srr * inv - mr * mr, vs = sss * inv - ms * ms;
+        const float stdthresh2 = params.stdthresh * params.stdthresh;
+        total += ((vr < stdthresh2) || (vs < stdthresh2)) ? 0.f : (srs * inv - mr * ms) * rsqrtf(vr * vs);
+        valid++;
+    }
+
+    return valid ? total / valid : -1.f;
+}
+
+__device__ inline
+float4 random_plane(const PatchMatchParams & params, const float3 ray, unsigned int & state)
+{
+    // Uniform in inverse depth
+    const float inear = 1.f / params.znear, ifar = 1.f / params.zfar;
+    float4 plane = make_float4(0.f, 0.f, 1.f, 1.f / (ifar + random_uniform(state) * (inear - ifar)));
+    if (!params.normals) return plane;
+
+    // Random normal facing the camera
+    float3 n = make_float3(random_uniform(state) - .5f, random_uniform(state) - .5f, random_uniform(state) - .5f);
+    n = normalize(n + make_float3(0.f, 0.f, 1e-6f));
+    if (dot(n, ray) < 0.f) n = -n;
+    plane.x = n.x; plane.y = n.y; plane.z = n.z;
+    return plane;
+}
+
+__global__ void patchmatch_init_kernel(float4 * __restrict__ d_plane, float * __restrict__ d_ncc,
+                                       const float * __restrict__ d_ref, const PatchMatchParams params,
+                                       const unsigned int seed, const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        unsigned int state = wang_hash(ind ^ wang_hash(seed));
+
+        const float3 ray = params.invK * make_float3(ind_x + 1, ind_y + 1, 1);
+        const float4 plane = random_plane(params, ray, state);
+        d_plane[ind] = plane;
+        d_ncc[ind] = patchmatch_ncc(d_ref, params, ind_x, ind_y, plane, width, height);
+    }
+}
+
+__global__ void patchmatch_propagate_kernel(float4 * __restrict__ d_plane, float * __restrict__ d_ncc,
+                                            const float * __restrict__ d_ref, const PatchMatchParams params,
+                                            const int parity, const int iteration, const unsigned int seed,
+                                            const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height) && (((ind_x + ind_y) & 1) == parity)) {
+        const int ind = ind_y * width + ind_x;
+        unsigned int state = wang_hash(ind ^ wang_hash(seed + 2 * iteration + parity));
+
+        const float3 ray = params.invK * make_float3(ind_x + 1, ind_y + 1, 1);
+        float4 best = d_plane[ind];
+        float bestncc = d_ncc[ind];
+
+        // Spatial propagation, neighbours at odd distances have the other checkerboard color
+        const int2 offsets[8] = { make_int2(-1, 0), make_int2(1, 0), make_int2(0, -1), make_int2(0, 1),
+                                  make_int2(-3, 0), make_int2(3, 0), make_int2(0, -3), make_int2(0, 3) };
+        for (int k = 0; k < 8; k++){
+            const int nx = ind_x + offsets[k].x, ny = ind_y + offsets[k].y;
+            if ((nx < 0) || (ny < 0) || (nx > width - 1) || (ny > height - 1)) continue;
+
+            // Depth of neighbour's plane at this pixel
+            float4 plane = d_plane[ny * width + nx];
+            const float3 n = make_float3(plane.x, plane.y, plane.z);
+            const float3 nray = params.invK * make_float3(nx + 1, ny + 1, 1);
+            const float denom = dot(n, ray);
+            if (denom <= 0.f) continue;
+            plane.w = plane.w * dot(n, nray) / denom;
+
+            const float ncc = patchmatch_ncc(d_ref, params, ind_x, ind_y, plane, width, height);
+            if (ncc > bestncc){
+                bestncc = ncc;
+                best = plane;
+            }
+        }
+
+        // Random refinement with range halving at each step and iteration
+        const float inear = 1.f / params.znear, ifar = 1.f / params.zfar;
+        float range = .5f / (1 << min(iteration, 16));
+        for (int k = 0; k < PATCHMATCH_REFINE_STEPS; k++, range *= .5f){
+            float4 plane = best;
+            const float idepth = fminf(fmaxf(1.f / best.w + (random_uniform(state) - .5f) * 2.f * range * (inear - ifar), ifar), inear);
+            plane.w = 1.f / idepth;
+            if (params.normals){
+                float3 n = make_float3(best.x, best.y, best.z) +
+                           range * make_float3(random_uniform(state) - .5f, random_uniform(state) - .5f, random_uniform(state) - .5f);
+                n = normalize(n);
+                if (dot(n, ray) <= 0.f) continue;
+                plane.x = n.x; plane.y = n.y; plane.z = n.z;
+            }
+
+            const float ncc = patchmatch_ncc(d_ref, params, ind_x, ind_y, plane, width, height);
+            if (ncc > bestncc){
+                bestncc = ncc;
+                best = plane;
+            }
+        }
+
+        d_plane[ind] = best;
+        d_ncc[ind] = bestncc;
+    }
+}
+
+__global__ void patchmatch_depthmap_kernel(float * __restrict__ d_depthmap, const float4 * __restrict__ d_plane,
+                                           const float * __restrict__ d_ncc, const float nccthreshold,
+                                           const int width, const int height, const float QNaN)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        d_depthmap[ind] = d_ncc[ind] > nccthreshold ? d_plane[ind].w : QNaN;
+    }
+}
+
+__global__ void patchmatch_grid_sweep_kernel(float * __restrict__ d_depth, float * __restrict__ d_ncc,
+                                             const float * __restrict__ d_ref, const PatchMatchParams params,
+                                             const float * __restrict__ d_planes, const int nplanes, const bool refine,
+                                             const int x0, const int y0, const int stride,
+                                             const int gridwidth, const int gridheight,
+                                             const int width, const int height, const float QNaN)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < gridwidth) && (ind_y < gridheight)) {
+        const int ind = ind_y * gridwidth + ind_x;
+        const int x = x0 + ind_x * stride, y = y0 + ind_y * stride;
+
+        // Fronto-parallel planes, NCC of neighbouring planes is kept for refinement
+        float best = -2.f, below = -2.f, above = -2.f, prev = -2.f;
+        int ibest = -1;
+        for (int k = 0; k < nplanes; k++){
+            const float ncc = patchmatch_ncc(d_ref, params, x, y, make_float4(0.f, 0.f, 1.f, d_planes[k]), width, height);
+            if (ncc > best){
+                below = prev;
+                above = -2.f;
+                best = ncc;
+                ibest = k;
+            }
+            else if (k == ibest + 1) above = ncc;
+            prev = ncc;
+        }
+
+        if (ibest < 0){
+            d_depth[ind] = QNaN;
+            d_ncc[ind] = -1.f;
+            return;
+        }
+
+        // Parabola fit in plane index, depth is interpolated between neighbouring planes
+        float depth = d_planes[ibest];
+        if (refine && (ibest > 0) && (ibest < nplanes - 1) && (below > -2.f) && (above > -2.f)){
+            const float denom = below - 2.f * best + above;
+            if (denom < 0.f){
+                const float offset = fminf(fmaxf(.5f * (below - above) / denom, -.5f), .5f);
+                depth += offset * (offset > 0.f ? d_planes[ibest + 1] - depth : depth - d_planes[ibest - 1]);
+            }
+        }
+
+        d_depth[ind] = depth;
+        d_ncc[ind] = best;
+    }
+}
+
+__global__ void candidates_insert_kernel(float * __restrict__ d_index, float * __restrict__ d_score,
+                                         const float * __restrict__ d_ncc, const int plane, const int ncandidates,
+                                         const int width, const int height)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const int layer = width * height;
+        const float ncc = d_ncc[ind];
+
+        // Candidates are kept sorted by score, worse ones are shifted down
+        if (!(ncc > d_score[ind + (ncandidates - 1) * layer])) return;
+        int c = ncandidates - 1;
+        for (; (c > 0) && (ncc > d_score[ind + (c - 1) * layer]); c--){
+            d_score[ind + c * layer] = d_score[ind + (c - 1) * layer];
+            d_index[ind + c * layer] = d_index[ind + (c - 1) * layer];
+        }
+        d_score[ind + c * layer] = ncc;
+        d_index[ind + c * layer] = plane;
+    }
+}
+
+__global__ void candidates_verify_kernel(float * __restrict__ d_depth, float * __restrict__ d_ncc,
+                                         const float * __restrict__ d_index, float * __restrict__ d_score,
+                                         float * __restrict__ d_weight, const float * __restrict__ d_planes,
+                                         const float * __restrict__ d_ref, const PatchMatchParams params,
+                                         const int ncandidates, const int width, const int height, const float QNaN)
+{
+    const int ind_x = threadIdx.x + blockDim.x * blockIdx.x;
+    const int ind_y = threadIdx.y + blockDim.y * blockIdx.y;
+
+    if ((ind_x < width) && (ind_y < height)) {
+        const int ind = ind_y * width + ind_x;
+        const int layer = width * height;
+        float best = -2.f, depth = QNaN;
+
+        for (int c = 0; c < ncandidates; c++){
+            const int k = d_index[ind + c * layer];
+            if (k < 0) break;
+
+            // Score so far is weighted by number of its sources, given sources are averaged by patchmatch_ncc
+            const float d = d_planes[k];
+            float score = d_score[ind + c * layer];
+            if (params.nsrc > 0){
+                const float fine = patchmatch_ncc(d_ref, params, ind_x, ind_y, make_float4(0.f, 0.f, 1.f, d), width, height);
+                if (fine > -1.f){
+                    const float weight = d_weight[ind + c * layer];
+                    score = (weight * score + params.nsrc * fine) / (weight + params.nsrc);
+                    d_score[ind + c * layer] = score;
+                    d_weight[ind + c * layer] = weight + params.nsrc;
+                }
+            }
+            if (score > best){
+                best = score;
+                depth = d;
+            }
+        }
+
+        d_depth[ind] = depth;
+        d_ncc[ind] = best;
+    }
+}
+
+void patchmatch_init(float4 * d_plane, float * d_ncc, const float * d_ref, const PatchMatchParams & params,
+                     const unsigned int seed, const int width, const int height, dim3 blocks, dim3 threads)
+{
+    patchmatch_init_kernel<<<blocks, threads>>>(d_plane, d_ncc, d_ref, params, seed, width, height);
+}
+
+void patchmatch_propagate(float4 * d_plane, float * d_ncc, const float * d_ref, const PatchMatchParams & params,
+                          const int parity, const int iteration, const unsigned int seed,
+                          const int width, const int height, dim3 blocks, dim3 threads)
+{
+    patchmatch_propagate_kernel<<<blocks, threads>>>(d_plane, d_ncc, d_ref, params, parity, iteration, seed, width, height);
+}
+
+void patchmatch_depthmap(float * d_depthmap, const float4 * d_plane, const float * d_ncc, const float nccthreshold,
+                         const int width, const int height, dim3 blocks, dim3 threads)
+{
+    const float QNan = std::numeric_limits<float>::quiet_NaN();
+    patchmatch_depthmap_kernel<<<blocks, threads>>>(d_depthmap, d_plane, d_ncc, nccthreshold, width, height, QNan);
+}
+
+void patchmatch_grid_sweep(float * d_depth, float * d_ncc, const float * d_ref, const PatchMatchParams & params,
+                           const float * d_planes, const int nplanes, const bool refine,
+                           const int x0, const int y0, const int stride, const int gridwidth, const int gridheight,
+                           const int width, const int height, dim3 blocks, dim3 threads)
+{
+    const float QNan = std::numeric_limits<float>::quiet_NaN();
+    patchmatch_grid_sweep_kernel<<<blocks, threads>>>(d_depth, d_ncc, d_ref, params, d_planes, nplanes, refine,
+                                                      x0, y0, stride, gridwidth, gridheight, width, height, QNan);
+}
+
+void candidates_insert(float * d_index, float * d_score, const float * d_ncc, const int plane, const int ncandidates,
+                       const int width, const int height, dim3 blocks, dim3 threads)
+{
+    candidates_insert_kernel<<<blocks, threads>>>(d_index, d_score, d_ncc, plane, ncandidates, width, height);
+}
+
+void candidates_verify(float * d_depth, float * d_ncc, const float * d_index, float * d_score, float * d_weight,
+                       const float * d_planes, const float * d_ref, const PatchMatchParams & params,
+                       const int ncandidates, const int width, const int height, dim3 blocks, dim3 threads)
+{
+    const float QNan = std::numeric_limits<float>::quiet_NaN();
+    candidates_verify_kernel<<<blocks, threads>>>(d_depth, d_ncc, d_index, d_score, d_weight, d_planes, d_ref, params,
+                                                  ncandidates, width, height, QNan);
+}
@@ -112,6 +112,9 @@ void PCLViewer::setupPlanesweep()
 
     ui->depthview->setScene(depthscene);
 
+    // Keep per source view planesweep results so threshold changes do not require sweeping again
+    ps.setSourceMapCaching(true);
+
     // Setup widget values
     ui->imNumber->setValue(ps.getNumberofImages());
     ui->winSize->setValue((ps.getWindowSize()));
@@ -408,6 +411,7 @@ void PCLViewer::LoadImages()
     ps.HostRef.reset(w, h);
     rgb2gray<float>(ps.HostRef.data(), refim);
     ps.HostRef.R = Rref; ps.HostRef.t = tref;
+    ps.ReferenceChanged();
 
     // setup source images
     QString src;
@@ -423,6 +427,7 @@ void PCLViewer::LoadImages()
         rgb2gray<float>(ps.HostSrc[i].data(), sources);
         ps.HostSrc[i].R = Rsrc[i]; ps.HostSrc[i].t = tsrc[i];
     }
+    ps.SourcesChanged();
 
     //ps.Convert8uTo32f(argc, argv);
 }
@@ -550,72 +555,84 @@ void PCLViewer::on_pSlider2_valueChanged(int value)
 void PCLViewer::on_denoiseBtn_clicked()
 {
     if (ps.CudaDenoise(argc, argv, ui->nIters->value(), ui->lambda->value(), ui->tvl1_tau->value(),
-                       ui->tvl1_sigma->value(), ui->tvl1_theta->value(), ui->tvl1_beta->value(), ui->tvl1_gamma->value())){
+                       ui->tvl1_sigma->value(), ui->tvl1_theta->value(), ui->tvl1_beta->value(), ui->tvl1_gamma->value()))
+        showDenoised();
+}
 
-        // get depthmaps
-        ui->maxthreads->setValue(ps.getMaxThreadsPerBlock());
-        dendepth = ps.getDepthmapDenoised();
-        dendepth8u = ps.getDepthmap8uDenoised();
+void PCLViewer::denoiseUpdate()
+{
+    // Only TVL1 parameters have changed, so solver continues from its previous solution
+    if (ps.CudaDenoiseUpdate(argc, argv, ui->nIters->value(), DEFAULT_TVL1_UPDATE_ITERATIONS, ui->lambda->value(),
+                             ui->tvl1_tau->value(), ui->tvl1_sigma->value(), ui->tvl1_theta->value(),
+                             ui->tvl1_beta->value(), ui->tvl1_gamma->value()))
+        showDenoised();
+}
 
-        // resize cloud if reference image has changed
-        if (refchangedtvl1)
+void PCLViewer::showDenoised()
+{
+    // get depthmaps
+    ui->maxthreads->setValue(ps.getMaxThreadsPerBlock());
+    dendepth = ps.getDepthmapDenoised();
+    dendepth8u = ps.getDepthmap8uDenoised();
+
+    // resize cloud if reference image has changed
+    if (refchangedtvl1)
+    {
+        if ((clouddenoised->height != dendepth8u->height()) || (clouddenoised->width != dendepth8u->width()))
         {
-            if ((clouddenoised->height != dendepth8u->height()) || (clouddenoised->width != dendepth8u->width()))
-            {
-                // The number of points in the cloud
-                clouddenoised->points.resize(dendepth8u->width() * dendepth8u->height());
-                clouddenoised->width = dendepth8u->width();
-                clouddenoised->height = dendepth8u->height();
-            }
+            // The number of points in the cloud
+            clouddenoised->points.resize(dendepth8u->width() * dendepth8u->height());
+            clouddenoised->width = dendepth8u->width();
+            clouddenoised->height = dendepth8u->height();
         }
+    }
 
-        QColor c;
-        int  i;
+    QColor c;
+    int  i;
 
-        Matrix3D k = ps.getInverseK();
-        double z;
+    Matrix3D k = ps.getInverseK();
+    double z;
 
-        // update colorbar range
-        ui->cbardenoised->setRangeMin(ui->zNear->value());
-        ui->cbardenoised->setRangeMax(ui->zFar->value());
+    // update colorbar range
+    ui->cbardenoised->setRangeMin(ui->zNear->value());
+    ui->cbardenoised->setRangeMax(ui->zFar->value());
 
-        // Fill the cloud
-        for (size_t x = 0; x < dendepth8u->width(); ++x)
-            for (size_t y = 0; y < dendepth8u->height(); ++y)
-            {
+    // Fill the cloud
+    for (size_t x = 0; x < dendepth8u->width(); ++x)
+        for (size_t y = 0; y < dendepth8u->height(); ++y)
+        {
 
-                i = x + y * dendepth8u->width();
+            i = x + y * dendepth8u->width();
 
-                z = dendepth->data()[i];
-                clouddenoised->points[i].z = sign(k(1,1)) * z;
-                clouddenoised->points[i].x = z * (k(0,0) * x + k(0,1) * y + k(0,2));
-                clouddenoised->points[i].y = z * (k(1,0) * x + k(1,1) * y + k(1,2));
+            z = dendepth->data()[i];
+            clouddenoised->points[i].z = sign(k(1,1)) * z;
+            clouddenoised->points[i].x = z * (k(0,0) * x + k(0,1) * y + k(0,2));
+            clouddenoised->points[i].y = z * (k(1,0) * x + k(1,1) * y + k(1,2));
 
-                // only update colors if reference image has changed
-                if (refchangedtvl1)
-                {
-                    c = refim.pixel(x, y);
-                    clouddenoised->points[i].r = c.red();
-                    clouddenoised->points[i].g = c.green();
-                    clouddenoised->points[i].b = c.blue();
-                }
+            // only update colors if reference image has changed
+            if (refchangedtvl1)
+            {
+                c = refim.pixel(x, y);
+                clouddenoised->points[i].r = c.red();
+                clouddenoised->points[i].g = c.green();
+                clouddenoised->points[i].b = c.blue();
             }
+        }
 
-        // show grayscale depthmap
-        QImage img(dendepth8u->data(), dendepth8u->width(), dendepth8u->height(), QImage::Format_Indexed8);
-        img.setColorTable(ctable);
+    // show grayscale depthmap
+    QImage img(dendepth8u->data(), dendepth8u->width(), dendepth8u->height(), QImage::Format_Indexed8);
+    img.setColorTable(ctable);
 
-        dendepthim = QPixmap::fromImage(img);
-        dendepthsc->addPixmap(dendepthim);
-        dendepthsc->setSceneRect(dendepthim.rect());
-        ui->denview->setScene(dendepthsc);
+    dendepthim = QPixmap::fromImage(img);
+    dendepthsc->addPixmap(dendepthim);
+    dendepthsc->setSceneRect(dendepthim.rect());
+    ui->denview->setScene(dendepthsc);
 
-        // show point cloud
-        viewerdenoised->updatePointCloud(clouddenoised, "cloud");
-        if (refchangedtvl1) viewerdenoised->resetCamera();
-        ui->qvtkDenoised->update();
-        refchangedtvl1 = false;
-    }
+    // show point cloud
+    viewerdenoised->updatePointCloud(clouddenoised, "cloud");
+    if (refchangedtvl1) viewerdenoised->resetCamera();
+    ui->qvtkDenoised->update();
+    refchangedtvl1 = false;
 }
 
 void PCLViewer::on_threadsx_valueChanged(int arg1)
@@ -817,16 +834,18 @@ void PCLViewer::on_loadfromdir_clicked()
     ps.HostRef.R = R;
     ps.HostRef.t = t;
     rgb2gray<float>(ps.HostRef.data(), refim);
+    ps.ReferenceChanged();
 
     int nsrc = ui->imNumber->value() - 1;
 
-    // load and setup source views
+    // load and setup twice as many candidate source views as needed, best are selected by their poses
+    int ncand = 2 * nsrc;
     ps.HostSrc.resize(0);
     QImage src;
-    int half = (nsrc + 1) / 2;
+    int half = (ncand + 1) / 2;
     int offset;
 
-    for (int i = 0; i < nsrc; i++){
+    for (int i = 0; i < ncand; i++){
         if (i < half) offset = i + 1;
         else offset = half - i - 1;
         imname = ImageName(ui->refNumber->value() + offset, impos);
@@ -840,6 +859,13 @@ void PCLViewer::on_loadfromdir_clicked()
             rgb2gray<float>(ps.HostSrc.back().data(), src);
         }
     }
+    ps.SourcesChanged();
+
+    // without any qualifying view only the first nsrc candidates are kept, not all of them
+    if ((ps.SelectSourceViews(nsrc) == 0) && ((int)ps.HostSrc.size() > nsrc)){
+        std::cerr << "Using first " << nsrc << " candidate source views" << std::endl;
+        ps.HostSrc.resize(nsrc);
+    }
 
     // load sparse groundtruth depthmap the same size as reference image
     QString depth = impos;
@@ -941,32 +967,32 @@ void PCLViewer::on_nIters_valueChanged(int arg1)
 
 void PCLViewer::on_lambda_valueChanged(double arg1)
 {
-    if (ui->tvl1_rtupdate_box->isChecked()) on_denoiseBtn_clicked();
+    if (ui->tvl1_rtupdate_box->isChecked()) denoiseUpdate();
 }
 
 void PCLViewer::on_tvl1_tau_valueChanged(double arg1)
 {
-    if (ui->tvl1_rtupdate_box->isChecked()) on_denoiseBtn_clicked();
+    if (ui->tvl1_rtupdate_box->isChecked()) denoiseUpdate();
 }
 
 void PCLViewer::on_tvl1_sigma_valueChanged(double arg1)
 {
-    if (ui->tvl1_rtupdate_box->isChecked()) on_denoiseBtn_clicked();
+    if (ui->tvl1_rtupdate_box->isChecked()) denoiseUpdate();
 }
 
 void PCLViewer::on_tvl1_theta_valueChanged(double arg1)
 {
-    if (ui->tvl1_rtupdate_box->isChecked()) on_denoiseBtn_clicked();
+    if (ui->tvl1_rtupdate_box->isChecked()) denoiseUpdate();
 }
 
 void PCLViewer::on_tvl1_beta_valueChanged(double arg1)
 {
-    if (ui->tvl1_rtupdate_box->isChecked()) on_denoiseBtn_clicked();
+    if (ui->tvl1_rtupdate_box->isChecked()) denoiseUpdate();
 }
 
 void PCLViewer::on_tvl1_gamma_valueChanged(double arg1)
 {
-    if (ui->tvl1_rtupdate_box->isChecked()) on_denoiseBtn_clicked();
+    if (ui->tvl1_rtupdate_box->isChecked()) denoiseUpdate();
 }
 
 void PCLViewer::on_reconstruct_button_clicked()
@@ -1007,6 +1033,11 @@ void PCLViewer::on_reconstruct_button_clicked()
     dim3 blocks(b.x, b.y, b.z);
     std::cerr << blocks.x << '\t' << blocks.y << '\t' << blocks.z << std::endl;
 
+    // Depth confidence gates histogram updates, it disables source view map cache, so it is restored afterwards
+    const bool confidencemaps = ps.getConfidenceMaps();
+    ps.setConfidenceMaps(true);
+    Image<float> confidence;
+
     // Run iterations
     int iterations = ui->fusion_iters->value();
 //    size_t pitch;
@@ -1036,13 +1067,21 @@ void PCLViewer::on_reconstruct_button_clicked()
 //                                ui->tgv_beta->value(), ui->tgv_gamma->value());
         ptr = ps.getDepthmapDenoisedPtr();
 
+        CamImage<float> * conf = ps.getConfidence();
+        if (conf){
+            confidence.reset(conf->width(), conf->height());
+            confidence.copyFrom(*conf);
+        }
+
         // Fuse the depthmap
-        FusionUpdateIteration<8>(fd, ptr, K, R, T, threshold, tau, lambda, sigma, ps.HostRef.width(), ps.HostRef.height(), blocks, threads);
+        FusionUpdateIteration<8>(fd, ptr, K, R, T, threshold, tau, lambda, sigma, ps.HostRef.width(), ps.HostRef.height(), blocks, threads,
+                                 conf ? confidence.data() : 0, DEFAULT_FUSION_MIN_CONFIDENCE);
 
         auto t2 = std::chrono::high_resolution_clock::now();
         std::cerr << "Time of 1 fusion iteration: " <<
                      std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
     }
+    ps.setConfidenceMaps(confidencemaps);
 
     // Resize point cloud to fit all voxels in the worst case scenario
     cloudfusion->points.resize(fd.elements());
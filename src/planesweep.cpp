@@ -1,5 +1,8 @@
 #include "planesweep.h"
 #include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
 
 // OpenCV:
 #ifdef OpenCV_FOUND
@@ -19,6 +22,15 @@
 #include <kernels.cu.h>
 #include <helper_structs.h>
 #include "inc/image.h"
+#include "hash.h"
+#include "matching_cost.h"
+#include "sgm.h"
+#include "guided_filter.h"
+#include "patchmatch.cu.h"
+#include "epipolar.cu.h"
+#include "rectified_stereo.h"
+#include "median_filter.h"
+#include "tvl1.h"
 
 template <typename T> // T models Any
 struct static_cast_func
@@ -73,6 +85,18 @@ PlaneSweep::PlaneSweep(int argc, char **argv) :
 
 bool PlaneSweep::RunAlgorithm(int argc, char **argv)
 {
+    confidenceavailable = false;
+
+    // Restrict work to region of interest or grid
+    if (!cropped && ((roiw * roih > 0) || (stride > 1))) return RunRegion(argc, argv);
+
+    // Rectified pairs only need horizontal disparity search
+    float baseline;
+    if (rectifiedfastpath && !cropped && (SourceCount() == 1) &&
+        (matchingcost == ZNCCcost) && !guidedfilter && isRectifiedPair(baseline, SourceIndex(0)) &&
+        (Source(0).width() == HostRef.width()) && (Source(0).height() == HostRef.height()))
+        return RunRectified(SourceIndex(0));
+
     auto t1 = std::chrono::high_resolution_clock::now();
 
     // Reset depthmap
@@ -100,31 +124,43 @@ bool PlaneSweep::RunAlgorithm(int argc, char **argv)
         if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
         blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
 
-        // Create images on the device to hold windowed mean and std for reference image + intermediate images
-        // and calculate the images
-        Image<float> deviceRefmean(w, h);
-        Image<float> deviceRefstd(w, h);
-        Image<float> devInter1(w, h); // intermediate image, will hold square of means in this computation
-        windowed_mean_column(devInter1.data(), deviceRef.data(), winsize, false, w, h,
-                             blocks, threads);
-        windowed_mean_row(deviceRefmean.data(), devInter1.data(), winsize, false, w, h,
-                          blocks, threads);
-
-        windowed_mean_column(devInter1.data(), deviceRef.data(), winsize, true, w, h,
-                             blocks, threads);
-        windowed_mean_row(deviceRefstd.data(), devInter1.data(), winsize, false, w, h,
-                          blocks, threads);
-
-        calculate_STD(deviceRefstd.data(), deviceRefmean.data(),
-                      deviceRefstd.data(), w, h, blocks, threads);
-
         // Create images to hold depthmap values and number of times it exceeded NCC threshold
         Image<float> devDepthmap(w, h);
         Image<float> devN(w, h);
 
-        int nimgs = std::min(std::max((int)numberimages, 1), (int)HostSrc.size());
-        for (int i = 0; i < nimgs; i++)
-            PlaneSweep::PlaneSweepThread(devDepthmap.data(), devN.data(), deviceRef.data(), deviceRefmean.data(), deviceRefstd.data(), i);
+        int nimgs = SourceCount();
+
+        // Create image to hold summed depth confidence, pruned sweep does not track NCC peaks
+        bool pruned = (matchingcost == ZNCCcost) && candidatepruning && (nimgs > (int)pruningsources);
+        Image<float> devConf;
+        if (confidencemaps && !pruned){
+            devConf.reset(w, h);
+            set_value(devConf.data(), 0.f, w, h, blocks, threads);
+        }
+        float * conf = devConf.isValid() ? devConf.data() : nullptr;
+
+        // Calculate plane depths for all source views
+        CalculatePlaneDepths(nimgs);
+        std::cout << "Number of planes used: " << planes.size() << "\n\n";
+
+        // Age of cached source view results
+        runcount++;
+
+        // Sweep source views with selected matching cost
+        switch (matchingcost){
+        case SADcost:
+            SweepSources<SADPolicy>(devDepthmap.data(), devN.data(), conf, deviceRef.data(), nimgs);
+            break;
+        case SSDcost:
+            SweepSources<SSDPolicy>(devDepthmap.data(), devN.data(), conf, deviceRef.data(), nimgs);
+            break;
+        case CensusCost:
+            SweepSources<CensusPolicy>(devDepthmap.data(), devN.data(), conf, deviceRef.data(), nimgs);
+            break;
+        default:
+            if (pruned) SweepPruned(devDepthmap.data(), devN.data(), deviceRef.data(), nimgs);
+            else SweepSources<ZNCCPolicy>(devDepthmap.data(), devN.data(), conf, deviceRef.data(), nimgs);
+        }
 
         // Calculate averaged depthmap
         element_rdivide(devDepthmap.data(), devDepthmap.data(), devN.data(), w, h, blocks, threads);
@@ -133,129 +169,1582 @@ bool PlaneSweep::RunAlgorithm(int argc, char **argv)
         // Check for kernel errors
         CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
 
-        // Copy depthmap to host
-        devDepthmap.copyTo(depthmap);
-        ConvertDepthtoUChar(depthmap, depthmap8u);
-        depthavailable = true;
+        // Copy depthmap to host
+        devDepthmap.copyTo(depthmap);
+        ConvertDepthtoUChar(depthmap, depthmap8u);
+        depthavailable = true;
+        depthgeneration++;
+
+        // Average confidence over source views, pixels without depth have zero confidence
+        confidenceavailable = conf != nullptr;
+        if (conf){
+            element_rdivide(conf, conf, devN.data(), w, h, blocks, threads);
+            set_QNAN_value(conf, 0.f, w, h, blocks, threads);
+            confidence.reset(w, h);
+            devConf.copyTo(confidence);
+        }
+
+        //-----------------------------------------------------
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Time taken for the algorithm to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+template<class Cost>
+void PlaneSweep::SweepSources(float *globDepth, float *globN, float *globConf, const float *Ref, const int nimgs)
+{
+    int w = HostRef.width(), h = HostRef.height();
+
+    // Calculate reference image data required by matching cost
+    Cost cost;
+    cost.prepareReference(Ref, winsize, stdthresh, w, h, blocks, threads);
+
+    // Calculate reference image statistics for guided filter cost aggregation
+    GuidedFilter guide;
+    if (guidedfilter) guide.prepareGuide(Ref, guidedradius, guidedeps, w, h, blocks, threads);
+
+    for (int i = 0; i < nimgs; i++)
+        PlaneSweepThread<Cost>(globDepth, globN, globConf, Ref, cost, guidedfilter ? &guide : nullptr, i);
+}
+
+template<class Cost>
+void PlaneSweep::PlaneSweepThread(float *globDepth, float *globN, float *globConf, const float *Ref, Cost &cost,
+                                  GuidedFilter *guide, const unsigned int &index)
+{
+    int w = HostRef.width(), h = HostRef.height();
+
+    // Create intermediate images to store current NCC, best NCC and current depthmap
+    Image<float> devNCC(w, h);
+    Image<float> devbestNCC(w, h);
+    Image<float> devDepth(w, h);
+
+    // Reuse cached results if source view, cameras, planes and parameters have not changed, cache holds no confidence
+    uint64_t key = 0;
+    if (cachesourcemaps && !globConf){
+        key = SourceMapsKey(index);
+        if (RestoreSourceMaps(key, devDepth.data(), devbestNCC.data())){
+            sum_depthmap_NCC(globDepth, globN,
+                             devDepth.data(), devbestNCC.data(),
+                             nccthresh, w, h,
+                             blocks, threads);
+            return;
+        }
+    }
+
+    // Create images to store current source view pyramid unless it is already shared on the device
+    std::vector<Image<float>> devSrc;
+
+    // Create matrices to hold relative rotation and transformation
+    Matrix3D Rrel;
+    Vector3D trel;
+
+    // Create intermediate image
+    Image<float> devInter1(w, h);
+
+    // Create images to store x and y indexes after transformation
+    Image<float> devx(w, h);
+    Image<float> devy(w, h);
+
+    // Create image to hold pixel values after transformation
+    Image<float> devWarped(w, h);
+
+    // Create images to store best plane index and NCC of neighbouring planes for sub-plane refinement
+    bool refine = (subplanerefinement != NoRefinement) && (planes.size() > 2);
+    Image<float> devBestIndex, devPrevNCC, devNCCbelow, devNCCabove;
+    if (refine){
+        devBestIndex.reset(w, h);
+        devPrevNCC.reset(w, h);
+        devNCCbelow.reset(w, h);
+        devNCCabove.reset(w, h);
+        set_value(devBestIndex.data(), -1.f, w, h, blocks, threads);
+    }
+
+    // Create image to store NCC peak statistics for depth confidence
+    Image<float4> devPeak;
+    if (globConf) devPeak.reset(w, h);
+
+    // Copy source view to device
+    const MipLevels src = DeviceSourceLevels(index, devSrc, mipmapping ? MAX_MIP_LEVELS : 1);
+
+    // Calculate relative rotation and translation:
+    RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, Source(index).R, Source(index).t);
+
+    // Get homographies for all planes
+    const HomographyTable & table = homographies.getTable(Rrel, trel, K, invK, planes);
+
+    // For each depth calculate NCC and update depthmap as required
+    for (size_t k = 0; k < planes.size(); k++){
+        float d = planes[k];
+
+        if (src.levels > 1) warp_mipmapped(devWarped.data(), src, table.H[k], w, h, blocks, threads);
+        else {
+            // Calculate transformed pixel coordinates
+            transform_indexes(devx.data(), devy.data(), table.H[k], w, h, blocks, threads);
+
+            // interpolate pixel values:
+            bilinear_interpolation(devWarped.data(), src.level[0],
+                                   devx.data(), devy.data(),
+                                   src.width[0], src.height[0],
+                                   devx.width(), devx.height(),
+                                   blocks, threads);
+        }
+
+        // We have no more use for devx and devy, we can use them to store intermediate results now
+        cost.similarity(devNCC.data(), Ref, devWarped.data(), devx.data(), devy.data(), devInter1.data(),
+                        winsize, w, h, blocks, threads);
+
+        // Aggregate similarity slice with reference image as guide
+        if (guide) guide->filter(devNCC.data(), Ref, devx.data(), devy.data(), devWarped.data(), devInter1.data(),
+                                 w, h, blocks, threads);
+
+        if (globConf) update_peak(devPeak.data(), devNCC.data(), k, w, h, blocks, threads);
+
+        // only keep depth and bestncc values for which best ncc is greater than current
+        // set other values to current ncc and depth
+        if (refine) update_arrays_subplane(devDepth.data(), devbestNCC.data(),
+                                           devBestIndex.data(), devPrevNCC.data(),
+                                           devNCCbelow.data(), devNCCabove.data(),
+                                           devNCC.data(), d, k, w, h,
+                                           blocks, threads);
+        else update_arrays(devDepth.data(), devbestNCC.data(),
+                           devNCC.data(), d, w, h,
+                           blocks, threads);
+
+    }
+
+    // Refine depth between planes
+    if (refine){
+        Image<float> devPlanes(planes.size(), 1);
+        devPlanes.copyFrom(planes.data(), planes.size() * sizeof(float));
+        refine_depth_subplane(devDepth.data(), devbestNCC.data(),
+                              devBestIndex.data(),
+                              devNCCbelow.data(), devNCCabove.data(),
+                              devPlanes.data(), planes.size(),
+                              subplanerefinement == EquiangularRefinement,
+                              w, h, blocks, threads);
+    }
+
+    if (cachesourcemaps && !globConf) StoreSourceMaps(key, devDepth.data(), devbestNCC.data());
+
+    if (globConf) sum_confidence(globConf, devPeak.data(), devbestNCC.data(), nccthresh, planes.size(),
+                                 w, h, blocks, threads);
+
+    sum_depthmap_NCC(globDepth, globN,
+                     devDepth.data(), devbestNCC.data(),
+                     nccthresh, w, h,
+                     blocks, threads);
+
+    return;
+}
+
+bool PlaneSweep::RunCostVolume(int argc, char **argv, const CostVolumeSink &sink, CostVolumeEncoding encoding,
+                               unsigned int slabsize)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+    printf("Starting cost volume generation...\n\n");
+
+    try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        int w = HostRef.width();
+        int h = HostRef.height();
+
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+        blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+
+        int nimgs = SourceCount();
+        CalculatePlaneDepths(nimgs);
+        slabsize = std::max(slabsize, 1u);
+
+        switch (matchingcost){
+        case SADcost:
+            CostVolumeSweep<SADPolicy>(sink, encoding, slabsize);
+            break;
+        case SSDcost:
+            CostVolumeSweep<SSDPolicy>(sink, encoding, slabsize);
+            break;
+        case CensusCost:
+            CostVolumeSweep<CensusPolicy>(sink, encoding, slabsize);
+            break;
+        default:
+            CostVolumeSweep<ZNCCPolicy>(sink, encoding, slabsize);
+        }
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Time taken for the cost volume to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+bool PlaneSweep::RunCostVolume(int argc, char **argv, const std::string &filename, CostVolumeEncoding encoding,
+                               unsigned int slabsize)
+{
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open()){
+        std::cerr << "Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    size_t planebytes = HostRef.width() * HostRef.height() * (encoding == CostVolume8U ? sizeof(unsigned char) : sizeof(unsigned short));
+    CostVolumeSink sink = [&file, planebytes](const void * data, unsigned int, unsigned int nplanes){
+        file.write((const char *)data, nplanes * planebytes);
+    };
+
+    return RunCostVolume(argc, argv, sink, encoding, slabsize) && file.good();
+}
+
+bool PlaneSweep::RunPatchMatch(int argc, char **argv, const unsigned int iterations, const bool normals,
+                               const unsigned int seed)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    printf("Starting PatchMatch algorithm...\n\n");
+
+    try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        int w = HostRef.width();
+        int h = HostRef.height();
+
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+        blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+
+        // Move reference and source views to device memory
+        Image<float> deviceRef(w, h);
+        deviceRef.copyFrom(HostRef);
+
+        int nimgs = SourceCount(PATCHMATCH_MAX_SOURCES);
+        std::vector<Image<float>> devSrc(nimgs);
+
+        PatchMatchParams params;
+        Matrix3D Rrel;
+        Vector3D trel;
+        params.K = K;
+        params.invK = invK;
+        params.nsrc = nimgs;
+        params.winsize = winsize;
+        params.stdthresh = stdthresh;
+        params.znear = znear;
+        params.zfar = zfar;
+        params.normals = normals;
+
+        for (int i = 0; i < nimgs; i++){
+            RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, Source(i).R, Source(i).t);
+            params.Rrel[i] = Rrel;
+            params.trel[i] = make_float3(trel.x, trel.y, trel.z);
+            params.src[i] = DeviceSource(i, devSrc[i]);
+            params.srcwidth[i] = Source(i).width();
+            params.srcheight[i] = Source(i).height();
+        }
+
+        // Create images to hold plane hypotheses and their NCC
+        Image<float4> devPlane(w, h);
+        Image<float> devNCC(w, h);
+        Image<float> devDepthmap(w, h);
+
+        patchmatch_init(devPlane.data(), devNCC.data(), deviceRef.data(), params, seed, w, h, blocks, threads);
+        for (unsigned int i = 0; i < iterations; i++){
+            patchmatch_propagate(devPlane.data(), devNCC.data(), deviceRef.data(), params, 0, i, seed, w, h, blocks, threads);
+            patchmatch_propagate(devPlane.data(), devNCC.data(), deviceRef.data(), params, 1, i, seed, w, h, blocks, threads);
+        }
+
+        patchmatch_depthmap(devDepthmap.data(), devPlane.data(), devNCC.data(), nccthresh, w, h, blocks, threads);
+        set_QNAN_value(devDepthmap.data(), zfar, w, h, blocks, threads);
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        // Copy depthmap to host
+        depthmap.reset(w, h);
+        devDepthmap.copyTo(depthmap);
+        ConvertDepthtoUChar(depthmap, depthmap8u);
+        depthavailable = true;
+        depthgeneration++;
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Time taken for the PatchMatch to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+bool PlaneSweep::RunSGM(int argc, char **argv, const unsigned int p1, const unsigned int p2, const unsigned int paths)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    int W = HostRef.width();
+    int H = HostRef.height();
+
+    // Reference view, planes and source sharing are changed while strips are swept
+    CamImage<float> full(W, H);
+    full.copyFrom(HostRef);
+    Matrix3D fullinvK = invK;
+    PlaneDistribution fulldist = planedistribution;
+    std::vector<float> fullcustom = customplanes;
+    bool fullshare = sharesources;
+
+    auto restore = [&](){
+        invK = fullinvK;
+        if ((int)HostRef.height() != H){
+            HostRef.reset(W, H);
+            HostRef.copyFrom(full);
+            ReferenceChanged();
+        }
+        planedistribution = fulldist;
+        customplanes = fullcustom;
+        sharesources = fullshare;
+        if (!fullshare) devicesources.clear();
+    };
+
+    try
+    {
+        // Plane depths of full image are used for all strips
+        int nimgs = SourceCount();
+        CalculatePlaneDepths(nimgs);
+        const int d = planes.size();
+        customplanes = planes;
+        planedistribution = CustomPlanes;
+        sharesources = true;
+
+        // Rows are aggregated in strips that fit in SGM_STRIP_MEMORY. Strips overlap, so that vertical and diagonal
+        // paths run SGM_STRIP_OVERLAP rows before reaching kept rows and matching windows of kept rows are complete.
+        const int overlap = SGM_STRIP_OVERLAP + winsize / 2;
+        const size_t rowbytes = (size_t)W * d * (sizeof(uint8_t) + sizeof(uint16_t));
+        const int maxrows = std::max((int)(SGM_STRIP_MEMORY / rowbytes), 1);
+        const int core = maxrows >= H ? H : std::max(maxrows - 2 * overlap, SGM_MIN_STRIP_ROWS);
+
+        CamImage<float> result(W, H);
+        std::vector<float> strip;
+
+        for (int sy0 = 0; sy0 < H; sy0 += core){
+            const int sy1 = std::min(sy0 + core, H);
+            const int y0 = core >= H ? 0 : std::max(sy0 - overlap, 0);
+            const int y1 = core >= H ? H : std::min(sy1 + overlap, H);
+            const int ch = y1 - y0;
+
+            // Reference view is replaced by its strip, shifted inverse K maps strip pixels to rays of full image
+            if (ch != H){
+                HostRef.reset(W, ch);
+                HostRef.copyFrom(full.data() + y0 * W, W * sizeof(float));
+                ReferenceChanged();
+                Matrix3D shift;
+                shift.makeIdentity();
+                shift(1,2) = y0;
+                invK = fullinvK * shift;
+            }
+
+            SGM sgm(W, ch, d);
+            sgm.setPenalties(p1, p2);
+            sgm.setPaths(paths);
+
+            if (!RunCostVolume(argc, argv, sgm.sink(), CostVolume8U)){
+                restore();
+                return false;
+            }
+
+            printf("Starting SGM aggregation of rows %d-%d...\n\n", sy0, sy1 - 1);
+            sgm.aggregate();
+
+            strip.resize((size_t)W * ch);
+            sgm.winnerTakesAll(strip.data(), planes);
+            std::copy(strip.begin() + (size_t)(sy0 - y0) * W, strip.begin() + (size_t)(sy1 - y0) * W,
+                      result.data() + (size_t)sy0 * W);
+        }
+
+        restore();
+
+        depthmap.reset(W, H);
+        depthmap.copyFrom(result);
+        for (int i = 0; i < W * H; i++)
+            if (depthmap.data()[i] != depthmap.data()[i]) depthmap.data()[i] = zfar;
+
+        ConvertDepthtoUChar(depthmap, depthmap8u);
+        depthavailable = true;
+        depthgeneration++;
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Time taken for the SGM to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        restore();
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+bool PlaneSweep::RunRectified(const unsigned int index)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    float baseline;
+    if ((index >= HostSrc.size()) || !isRectifiedPair(baseline, index)){
+        std::cerr << "Reference and source view are not a rectified pair" << std::endl;
+        return false;
+    }
+
+    int w = HostRef.width();
+    int h = HostRef.height();
+
+    if ((HostSrc[index].width() != (size_t)w) || (HostSrc[index].height() != (size_t)h)){
+        std::cerr << "Reference and source view sizes do not match" << std::endl;
+        return false;
+    }
+
+    printf("Starting rectified stereo disparity search...\n\n");
+
+    // Source pixel of depth z is shifted by f * tx / z
+    const float fb = K(0,0) * std::fabs(baseline);
+    const int dmin = std::max((int)std::floor(fb / zfar), 0);
+    const int dmax = std::min((int)std::ceil(fb / znear), w - 1);
+    std::cout << "Number of disparities used: " << dmax - dmin + 1 << "\n\n";
+
+    RectifiedStereo stereo(w, h);
+    stereo.setWindowSize(winsize);
+    stereo.setThresholds(stdthresh, nccthresh);
+
+    depthmap.reset(w, h);
+    stereo.compute(depthmap.data(), HostRef.data(), HostSrc[index].data(), dmin, dmax, baseline > 0 ? 1 : -1, fb);
+    for (int i = 0; i < w * h; i++)
+        if (depthmap.data()[i] != depthmap.data()[i]) depthmap.data()[i] = zfar;
+
+    ConvertDepthtoUChar(depthmap, depthmap8u);
+    depthavailable = true;
+    depthgeneration++;
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::cout << "Time taken for the rectified stereo to complete is " <<
+                 std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+    std::cout.flush();
+
+    return true;
+}
+
+bool PlaneSweep::isRectifiedPair(float &baseline, const unsigned int index) const
+{
+    if (index >= HostSrc.size()) return false;
+
+    Matrix3D Rrel;
+    Vector3D trel;
+    RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, HostSrc[index].R, HostSrc[index].t);
+
+    for (unsigned char i = 0; i < 3; i++)
+        for (unsigned char j = 0; j < 3; j++)
+            if (std::fabs(Rrel(i,j) - (i == j ? 1.f : 0.f)) > RECTIFIED_TOLERANCE) return false;
+
+    baseline = trel.x;
+    return (std::fabs(trel.x) > 0.f) &&
+           (std::fabs(trel.y) <= RECTIFIED_TOLERANCE * std::fabs(trel.x)) &&
+           (std::fabs(trel.z) <= RECTIFIED_TOLERANCE * std::fabs(trel.x));
+}
+
+const float * PlaneSweep::DeviceSource(const unsigned int i, Image<float> &local)
+{
+    if (sharesources){
+        std::vector<Image<float>> unused;
+        return DeviceSourceLevels(i, unused, 1).level[0];
+    }
+
+    const CamImage<float> & src = Source(i);
+    local.reset(src.width(), src.height());
+    local.copyFrom(src);
+    return local.data();
+}
+
+MipLevels PlaneSweep::DeviceSourceLevels(const unsigned int i, std::vector<Image<float>> &local, const int nlevels)
+{
+    const CamImage<float> & src = Source(i);
+    std::vector<Image<float>> & levels = sharesources ? devicesources[src.data()] : local;
+
+    // Levels are allocated in place, so vector must not grow afterwards
+    if (levels.size() < MAX_MIP_LEVELS) levels.resize(MAX_MIP_LEVELS);
+    if (!levels[0].isValid()){
+        levels[0].reset(src.width(), src.height());
+        levels[0].copyFrom(src);
+    }
+
+    MipLevels mip;
+    mip.levels = 0;
+    int w = src.width(), h = src.height();
+    for (int l = 0; (l < nlevels) && (l < MAX_MIP_LEVELS); l++){
+        if (l > 0){
+            if ((w / 2 < MIN_MIP_SIZE) || (h / 2 < MIN_MIP_SIZE)) break;
+            w /= 2;
+            h /= 2;
+            if (!levels[l].isValid()){
+                levels[l].reset(w, h);
+                dim3 levelblocks(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+                downsample(levels[l].data(), levels[l - 1].data(), levels[l - 1].width(), levels[l - 1].height(),
+                           w, h, levelblocks, threads);
+            }
+        }
+        mip.level[l] = levels[l].data();
+        mip.width[l] = w;
+        mip.height[l] = h;
+        mip.levels++;
+    }
+
+    return mip;
+}
+
+const std::vector<Image<float>> & PlaneSweep::DeviceTensor(const double beta, const double gamma)
+{
+    int w = HostRef.width(), h = HostRef.height();
+    float params[2] = {(float)beta, (float)gamma};
+    int size[2] = {w, h};
+    uint64_t key = HashBytes(&refgeneration, sizeof(refgeneration));
+    key = HashBytes(size, sizeof(size), key);
+    key = HashBytes(params, sizeof(params), key);
+
+    if ((key == tensorkey) && (devicetensor.size() == 4) && devicetensor[0].isValid()) return devicetensor;
+
+    // Tensor images are allocated in place, so vector must not grow afterwards
+    devicetensor.resize(4);
+    for (auto & T : devicetensor) T.reset(w, h);
+
+    Image<float> ref(w, h);
+    dim3 refblocks(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+    ref.copyFrom(HostRef);
+    element_scale(ref.data(), 1/255.f, w, h, refblocks, threads);
+    Anisotropic_diffusion_tensor(devicetensor[0].data(), devicetensor[1].data(), devicetensor[2].data(), devicetensor[3].data(),
+                                 ref.data(), beta, gamma, w, h, refblocks, threads);
+    tensorkey = key;
+
+    return devicetensor;
+}
+
+size_t PlaneSweep::DeviceDepthmap(const int w, const int h)
+{
+    if (d_depthmap && (w == d_depthmapw) && (h == d_depthmaph)) return d_depthmappitch;
+
+    CHECK_CUDA_ERRORS_AUTO(cudaFree(d_depthmap));
+    d_depthmap = 0;
+    d_depthmapw = d_depthmaph = 0;
+    CHECK_CUDA_ERRORS_AUTO(cudaMallocPitch(&d_depthmap, &d_depthmappitch, w * sizeof(float), h));
+    d_depthmapw = w;
+    d_depthmaph = h;
+
+    return d_depthmappitch;
+}
+
+bool PlaneSweep::RunRegion(int argc, char **argv)
+{
+    int W = HostRef.width(), H = HostRef.height();
+
+    // Requested region clipped to image
+    const bool roi = roiw * roih > 0;
+    const int rx0 = roi ? std::min((int)roix, W) : 0, ry0 = roi ? std::min((int)roiy, H) : 0;
+    const int rx1 = roi ? std::min((int)(roix + roiw), W) : W, ry1 = roi ? std::min((int)(roiy + roih), H) : H;
+    if ((rx1 <= rx0) || (ry1 <= ry0)){
+        std::cerr << "Region of interest is outside of reference image" << std::endl;
+        return false;
+    }
+
+    if (stride > 1) return RunGrid(argc, argv, rx0, ry0, rx1, ry1);
+
+    // Region with window halo, windows of region pixels must see the same data as in full image
+    const int halo = winsize / 2 + (guidedfilter ? guidedradius : 0);
+    const int x0 = std::max(rx0 - halo, 0), y0 = std::max(ry0 - halo, 0);
+    const int x1 = std::min(rx1 + halo, W), y1 = std::min(ry1 + halo, H);
+    const int cw = x1 - x0, ch = y1 - y0;
+
+    // Reference view is replaced by its crop, shifted inverse K maps crop pixels to rays of full image
+    CamImage<float> full(W, H);
+    full.copyFrom(HostRef);
+    HostRef.reset(cw, ch);
+    HostRef.copyFrom(full.data() + y0 * W + x0, W * sizeof(float));
+    ReferenceChanged();
+
+    Matrix3D fullinvK = invK, shift;
+    shift.makeIdentity();
+    shift(0,2) = x0;
+    shift(1,2) = y0;
+    invK = fullinvK * shift;
+
+    cropped = true;
+    bool success = RunAlgorithm(argc, argv);
+    cropped = false;
+
+    invK = fullinvK;
+    HostRef.reset(W, H);
+    HostRef.copyFrom(full);
+    ReferenceChanged();
+    if (!success) return false;
+
+    // Paste region into full size depthmap, pixels outside of it are at far plane
+    CamImage<float> crop(cw, ch);
+    crop.copyFrom(depthmap);
+    depthmap.reset(W, H);
+    std::fill(depthmap.data(), depthmap.data() + W * H, zfar);
+    for (int y = ry0; y < ry1; y++)
+        std::copy(crop.data() + (y - y0) * cw + rx0 - x0, crop.data() + (y - y0) * cw + rx1 - x0,
+                  depthmap.data() + y * W + rx0);
+    depthgeneration++;
+
+    if (confidenceavailable){
+        crop.copyFrom(confidence);
+        confidence.reset(W, H);
+        std::fill(confidence.data(), confidence.data() + W * H, 0.f);
+        for (int y = ry0; y < ry1; y++)
+            std::copy(crop.data() + (y - y0) * cw + rx0 - x0, crop.data() + (y - y0) * cw + rx1 - x0,
+                      confidence.data() + y * W + rx0);
+    }
+
+    ConvertDepthtoUChar(depthmap, depthmap8u);
+    return true;
+}
+
+bool PlaneSweep::RunGrid(int argc, char **argv, const int x0, const int y0, const int x1, const int y1)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    printf("Starting strided plane sweep...\n\n");
+
+    try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        int w = HostRef.width();
+        int h = HostRef.height();
+        int gw = (x1 - x0 + stride - 1) / stride;
+        int gh = (y1 - y0 + stride - 1) / stride;
+
+        // Kernel grid covers grid points only
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+        dim3 gridblocks(ceil(gw/(float)threads.x), ceil(gh/(float)threads.y));
+
+        Image<float> deviceRef(w, h);
+        deviceRef.copyFrom(HostRef);
+
+        int nimgs = SourceCount(PATCHMATCH_MAX_SOURCES);
+        CalculatePlaneDepths(nimgs);
+        std::cout << "Number of planes used: " << planes.size() << "\n\n";
+
+        std::vector<Image<float>> devSrc(nimgs);
+        PatchMatchParams params;
+        Matrix3D Rrel;
+        Vector3D trel;
+        params.K = K;
+        params.invK = invK;
+        params.nsrc = nimgs;
+        params.winsize = winsize;
+        params.stdthresh = stdthresh;
+        params.znear = znear;
+        params.zfar = zfar;
+        params.normals = false;
+
+        for (int i = 0; i < nimgs; i++){
+            RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, Source(i).R, Source(i).t);
+            params.Rrel[i] = Rrel;
+            params.trel[i] = make_float3(trel.x, trel.y, trel.z);
+            params.src[i] = DeviceSource(i, devSrc[i]);
+            params.srcwidth[i] = Source(i).width();
+            params.srcheight[i] = Source(i).height();
+        }
+
+        Image<float> devPlanes(planes.size(), 1);
+        devPlanes.copyFrom(planes.data(), planes.size() * sizeof(float));
+        Image<float> devDepth(gw, gh);
+        Image<float> devNCC(gw, gh);
+
+        patchmatch_grid_sweep(devDepth.data(), devNCC.data(), deviceRef.data(), params, devPlanes.data(), planes.size(),
+                              subplanerefinement != NoRefinement, x0, y0, stride, gw, gh, w, h, gridblocks, threads);
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        CamImage<float> depth(gw, gh), ncc(gw, gh);
+        devDepth.copyTo(depth);
+        devNCC.copyTo(ncc);
+
+        // Grid points above NCC threshold are written to depthmap and point list
+        depthmap.reset(w, h);
+        std::fill(depthmap.data(), depthmap.data() + w * h, zfar);
+        gridpoints.clear();
+        for (int y = 0; y < gh; y++)
+            for (int x = 0; x < gw; x++){
+                const float d = depth.data()[y * gw + x], c = ncc.data()[y * gw + x];
+                if ((d != d) || (c < nccthresh)) continue;
+                DepthPoint p = {(unsigned int)(x0 + x * stride), (unsigned int)(y0 + y * stride), d, c};
+                depthmap.data()[p.y * w + p.x] = d;
+                gridpoints.push_back(p);
+            }
+
+        ConvertDepthtoUChar(depthmap, depthmap8u);
+        depthavailable = true;
+        depthgeneration++;
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Time taken for the strided plane sweep of " << gw * gh << " points to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+bool PlaneSweep::RunBatch(int argc, char **argv, const std::vector<CamImage<float>> &frames,
+                          const std::vector<unsigned int> &refs, const unsigned int window,
+                          std::vector<CamImage<float>> &depthmaps, const bool select)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    if (frames.empty()) return false;
+    int w = frames[0].width(), h = frames[0].height();
+
+    // Every frame can be a reference, which is copied into reference image of the first frame size
+    for (const auto & frame : frames)
+        if (((int)frame.width() != w) || ((int)frame.height() != h)){
+            std::cerr << "Frames of the batch must have the same size" << std::endl;
+            return false;
+        }
+
+    // Keep current views, frames are referenced by HostSrc without copying
+    CamImage<float> savedref;
+    if (HostRef.area()){
+        savedref.reset(HostRef.width(), HostRef.height());
+        savedref.copyFrom(HostRef);
+    }
+    savedref.R = HostRef.R;
+    savedref.t = HostRef.t;
+    std::vector<CamImage<float>> savedsrc;
+    savedsrc.swap(HostSrc);
+    std::vector<unsigned int> savedviews;
+    savedviews.swap(sourceviews);
+
+    // HostSrc aliases frames while batch runs, so views are restored on every exit path
+    auto restore = [&](){
+        sharesources = false;
+        devicesources.clear();
+
+        HostSrc.swap(savedsrc);
+        sourceviews.swap(savedviews);
+        SourcesChanged();
+        if (savedref.area()){
+            HostRef.reset(savedref.width(), savedref.height());
+            HostRef.copyFrom(savedref);
+        }
+        HostRef.R = savedref.R;
+        HostRef.t = savedref.t;
+        ReferenceChanged();
+    };
+
+    sharesources = true;
+    bool success = true;
+    depthmaps.resize(refs.size());
+
+    try
+    {
+        HostRef.reset(w, h);
+        for (size_t i = 0; i < refs.size(); i++){
+            const unsigned int r = refs[i];
+            if (r >= frames.size()){
+                success = false;
+                continue;
+            }
+
+            HostRef.copyFrom(frames[r]);
+            HostRef.R = frames[r].R;
+            HostRef.t = frames[r].t;
+            ReferenceChanged();
+
+            HostSrc.clear();
+            sourceviews.clear();
+            for (unsigned int j = r > window ? r - window : 0; (j <= r + window) && (j < frames.size()); j++)
+                if (j != r) HostSrc.push_back(frames[j]);
+            SourcesChanged();
+
+            // Reference without any usable source view has no depthmap
+            if (select ? SelectSourceViews(numberimages) == 0 : HostSrc.empty()){
+                success = false;
+                continue;
+            }
+
+            if (!RunAlgorithm(argc, argv)){
+                success = false;
+                continue;
+            }
+
+            depthmaps[i].reset(w, h);
+            depthmaps[i].copyFrom(depthmap);
+            depthmaps[i].R = HostRef.R;
+            depthmaps[i].t = HostRef.t;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Exception caught: ";
+        std::cerr << e.what() << std::endl;
+
+        restore();
+        return false;
+    }
+
+    restore();
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::cout << "Time taken for the batch of " << refs.size() << " references to complete is " <<
+                 std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+    std::cout.flush();
+
+    return success;
+}
+
+float PlaneSweep::SourceViewScore(const unsigned int index) const
+{
+    if (index >= HostSrc.size()) return 0.f;
+
+    int w = HostRef.width(), h = HostRef.height();
+    const CamImage<float> & src = HostSrc[index];
+    Matrix3D Rrel;
+    Vector3D trel;
+    RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, src.R, src.t);
+
+    // Source camera center in reference camera coordinates
+    const float3 t = make_float3(trel.x, trel.y, trel.z);
+    const float3 C = Rrel.trans() * t * -1.f;
+    const float z = 2.f / (1.f / znear + 1.f / zfar);
+    const float deg = 57.2957795f; // 180 / pi
+
+    float score = 0.f;
+    int visible = 0;
+    for (int y = 0; y < SOURCE_SELECTION_GRID; y++)
+        for (int x = 0; x < SOURCE_SELECTION_GRID; x++){
+            const float3 p = make_float3(1 + (x + .5f) * w / SOURCE_SELECTION_GRID,
+                                         1 + (y + .5f) * h / SOURCE_SELECTION_GRID, 1.f);
+            const float3 X = invK * p * z;
+            const float3 q = K * (Rrel * X + t);
+            if ((q.z <= 0.f) || (q.x / q.z < 1) || (q.y / q.z < 1) ||
+                (q.x / q.z > src.width()) || (q.y / q.z > src.height())) continue;
+            visible++;
+
+            const float3 a = X * -1.f, b = C - X;
+            const float angle = deg * std::acos(std::min(std::max(dot(a, b) / (length(a) * length(b)), -1.f), 1.f));
+            const float sigma = angle <= SOURCE_SELECTION_ANGLE ? SOURCE_SELECTION_SIGMA_LOW : SOURCE_SELECTION_SIGMA_HIGH;
+            const float diff = angle - SOURCE_SELECTION_ANGLE;
+            score += std::exp(-diff * diff / (2.f * sigma * sigma));
+        }
+
+    const int npoints = SOURCE_SELECTION_GRID * SOURCE_SELECTION_GRID;
+    if (visible < SOURCE_SELECTION_MIN_OVERLAP * npoints) return 0.f;
+    return score / npoints;
+}
+
+unsigned int PlaneSweep::SelectSourceViews(const unsigned int k)
+{
+    std::vector<std::pair<float, unsigned int>> scores;
+    for (unsigned int i = 0; i < HostSrc.size(); i++){
+        const float score = SourceViewScore(i);
+        if (score > 0.f) scores.push_back(std::make_pair(score, i));
+    }
+
+    std::stable_sort(scores.begin(), scores.end(),
+                     [](const std::pair<float, unsigned int> & a, const std::pair<float, unsigned int> & b){
+        return a.first > b.first; });
+
+    sourceviews.clear();
+    for (size_t i = 0; (i < scores.size()) && (i < k); i++) sourceviews.push_back(scores[i].second);
+
+    if (sourceviews.empty()) std::cerr << "No source view qualifies for selection" << std::endl;
+    else std::cout << sourceviews.size() << " of " << HostSrc.size() << " source views selected, best score "
+                   << scores.front().first << "\n\n";
+
+    return sourceviews.size();
+}
+
+bool PlaneSweep::RunSemiDense(int argc, char **argv, const float gradthresh)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    printf("Starting semi-dense epipolar search...\n\n");
+
+    try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        int w = HostRef.width();
+        int h = HostRef.height();
+
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+        blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+
+        // Move reference and source views to device memory
+        Image<float> deviceRef(w, h);
+        deviceRef.copyFrom(HostRef);
+
+        int nimgs = SourceCount(EPIPOLAR_MAX_SOURCES);
+        std::vector<Image<float>> devSrc(nimgs);
+
+        EpipolarParams params;
+        Matrix3D Rrel;
+        Vector3D trel;
+        params.nsrc = nimgs;
+        params.stdthresh = stdthresh;
+        params.nccthresh = nccthresh;
+
+        for (int i = 0; i < nimgs; i++){
+            RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, Source(i).R, Source(i).t);
+            const float3 t = make_float3(trel.x, trel.y, trel.z);
+            params.A[i] = K * Rrel * invK;
+            params.b[i] = K * t;
+            params.src[i] = DeviceSource(i, devSrc[i]);
+
+            // First source view camera center projected to reference view gives epipole
+            if (i == 0) params.epipole = K * (Rrel.trans() * t) * -1.f;
+        }
+
+        Image<float> devDepth(w, h);
+        Image<float> devNCC(w, h);
+        Image<uchar> devMask(w, h);
+
+        semidense_depth(devDepth.data(), devNCC.data(), devMask.data(), deviceRef.data(), params, gradthresh,
+                        znear, zfar, w, h, blocks, threads);
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        CamImage<float> ncc(w, h);
+        semidensedepth.reset(w, h);
+        semidensemask.reset(w, h);
+        devDepth.copyTo(semidensedepth);
+        devNCC.copyTo(ncc);
+        devMask.copyTo(semidensemask);
+        semidensedepth.R = HostRef.R;
+        semidensedepth.t = HostRef.t;
+
+        // Gather sparse list of measurements
+        semidensepoints.clear();
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++){
+                const int ind = y * w + x;
+                if (semidensemask.data()[ind]){
+                    DepthPoint p = {(unsigned int)x, (unsigned int)y, semidensedepth.data()[ind], ncc.data()[ind]};
+                    semidensepoints.push_back(p);
+                }
+            }
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Semi-dense depth found for " << semidensepoints.size() << " of " << w * h << " pixels\n";
+        std::cout << "Time taken for the semi-dense search to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+bool PlaneSweep::DepthFilterKeyframe(int argc, char **argv, const bool reset)
+{
+    try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        int w = HostRef.width();
+        int h = HostRef.height();
+
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+        blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+
+        Image<float4> devState(w, h);
+        depth_filter_init(devState.data(), 1.f / zfar, 1.f / znear, w, h, blocks, threads);
+
+        // Move state of previous keyframe to reference view
+        if (!reset && devfilterstate.isValid() && (devfilterstate.width() == (size_t)w) && (devfilterstate.height() == (size_t)h)){
+            Matrix3D Rrel;
+            Vector3D trel;
+            RelativeMatrices(Rrel, trel, filterkeyframe.R, filterkeyframe.t, HostRef.R, HostRef.t);
+
+            Image<float> devNearest(w, h);
+            set_value(devNearest.data(), 0.f, w, h, blocks, threads);
+            depth_filter_propagate(devState.data(), devNearest.data(), devfilterstate.data(), K * Rrel * invK,
+                                   K * make_float3(trel.x, trel.y, trel.z), w, h, blocks, threads);
+        }
+
+        // State, keyframe and active pixel lists stay on the device until next keyframe
+        devfilterstate.reset(w, h);
+        devfilterstate.copyFrom(devState);
+        devfilterkeyframe.reset(w, h);
+        devfilterkeyframe.copyFrom(HostRef);
+
+        // Lists are allocated in place, so vector must not grow afterwards
+        devfilterlists.resize(2);
+        for (auto & list : devfilterlists) list.reset(w * h, 1);
+        devfiltercount.reset(1, 1);
+        filterlist = 0;
+
+        CHECK_CUDA_ERRORS_AUTO(cudaMemset(devfiltercount.data(), 0, sizeof(unsigned int)));
+        depth_filter_active(devfilterlists[filterlist].data(), devfiltercount.data(), devfilterstate.data(),
+                            1.f / zfar, 1.f / znear, w, h, blocks, threads);
+        CHECK_CUDA_ERRORS_AUTO(cudaMemcpy(&filteractive, devfiltercount.data(), sizeof(unsigned int), cudaMemcpyDeviceToHost));
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        filterkeyframe.reset(w, h);
+        filterkeyframe.copyFrom(HostRef);
+        filterkeyframe.R = HostRef.R;
+        filterkeyframe.t = HostRef.t;
+
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+bool PlaneSweep::DepthFilterUpdate(int argc, char **argv, const CamImage<float> &frame, const float gradthresh)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    int w = filterkeyframe.width();
+    int h = filterkeyframe.height();
+
+    if ((w * h == 0) || !devfilterstate.isValid() || (frame.width() != (size_t)w) || (frame.height() != (size_t)h)){
+        std::cerr << "Depth filter keyframe is not set or frame size does not match" << std::endl;
+        return false;
+    }
+
+    try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+
+        // Only new frame is uploaded, frame buffer is reused while size does not change
+        if ((devfilterframe.width() != (size_t)w) || (devfilterframe.height() != (size_t)h)) devfilterframe.reset(w, h);
+        devfilterframe.copyFrom(frame);
+
+        EpipolarParams params;
+        Matrix3D Rrel;
+        Vector3D trel;
+        RelativeMatrices(Rrel, trel, filterkeyframe.R, filterkeyframe.t, frame.R, frame.t);
+        const float3 t = make_float3(trel.x, trel.y, trel.z);
+        params.A[0] = K * Rrel * invK;
+        params.b[0] = K * t;
+        params.src[0] = devfilterframe.data();
+        params.nsrc = 1;
+        params.epipole = K * (Rrel.trans() * t) * -1.f;
+        params.stdthresh = stdthresh;
+        params.nccthresh = nccthresh;
+
+        // Pixels still active after update are collected into the other list
+        const unsigned int searched = filteractive;
+        CHECK_CUDA_ERRORS_AUTO(cudaMemset(devfiltercount.data(), 0, sizeof(unsigned int)));
+        depth_filter_update(devfilterstate.data(), devfilterkeyframe.data(), params, gradthresh, 1.f / zfar, 1.f / znear,
+                            devfilterlists[filterlist].data(), filteractive,
+                            devfilterlists[1 - filterlist].data(), devfiltercount.data(), w, h, threads);
+        CHECK_CUDA_ERRORS_AUTO(cudaMemcpy(&filteractive, devfiltercount.data(), sizeof(unsigned int), cudaMemcpyDeviceToHost));
+        filterlist = 1 - filterlist;
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Depth filter searched " << searched << " active pixels, " << filteractive << " remain active\n";
+        std::cout << "Time taken for the depth filter update to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: \n";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+unsigned int PlaneSweep::DepthFilterExport()
+{
+    int w = devfilterstate.width();
+    int h = devfilterstate.height();
+
+    if (!devfilterstate.isValid() || (w * h == 0)) return 0;
+
+    // State is downloaded only here
+    filterstate.reset(w, h);
+    devfilterstate.copyTo(filterstate);
+
+    const float range = 1.f / znear - 1.f / zfar;
+    const float maxvar = DEPTH_FILTER_CONVERGED_STD * DEPTH_FILTER_CONVERGED_STD * range * range;
+    unsigned int converged = 0;
+
+    depthmap.reset(w, h);
+    for (int i = 0; i < w * h; i++){
+        const float4 s = filterstate.data()[i];
+        if ((s.y < maxvar) && (s.z / (s.z + s.w) > DEPTH_FILTER_CONVERGED_INLIER) && (s.x > 0.f)){
+            depthmap.data()[i] = 1.f / s.x;
+            converged++;
+        }
+        else depthmap.data()[i] = zfar;
+    }
+    depthmap.R = filterkeyframe.R;
+    depthmap.t = filterkeyframe.t;
+
+    ConvertDepthtoUChar(depthmap, depthmap8u);
+    depthavailable = true;
+    depthgeneration++;
+
+    std::cout << "Depth filter converged for " << converged << " of " << w * h << " pixels\n\n";
+    std::cout.flush();
+
+    return converged;
+}
+
+template<class Cost>
+void PlaneSweep::CostVolumeSweep(const CostVolumeSink &sink, CostVolumeEncoding encoding, unsigned int slabsize)
+{
+    int w = HostRef.width(), h = HostRef.height();
+    int nimgs = SourceCount();
+    size_t planebytes = w * h * (encoding == CostVolume8U ? sizeof(unsigned char) : sizeof(unsigned short));
+
+    // Move reference image to device memory and calculate data required by matching cost
+    Image<float> deviceRef(w, h);
+    deviceRef.copyFrom(HostRef);
+    Cost cost;
+    cost.prepareReference(deviceRef.data(), winsize, stdthresh, w, h, blocks, threads);
+
+    // Move source views to device memory and get their homographies
+    Matrix3D Rrel;
+    Vector3D trel;
+    std::vector<std::vector<Image<float>>> devSrc(nimgs);
+    std::vector<MipLevels> src(nimgs);
+    std::vector<HomographyTable> tables(nimgs);
+    for (int i = 0; i < nimgs; i++){
+        src[i] = DeviceSourceLevels(i, devSrc[i], mipmapping ? MAX_MIP_LEVELS : 1);
+        RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, Source(i).R, Source(i).t);
+        tables[i] = homographies.getTable(Rrel, trel, K, invK, planes);
+    }
+
+    // Create images to hold summed and current similarity and intermediate results
+    Image<float> devSum(w, h), devSim(w, h), devx(w, h), devy(w, h), devWarped(w, h), devInter1(w, h);
+
+    // Create slab buffers on device and host
+    Image<unsigned char> devSlab(planebytes * slabsize, 1);
+    std::vector<unsigned char> hostSlab(planebytes * slabsize);
+
+    for (size_t first = 0; first < planes.size(); first += slabsize){
+        unsigned int n = std::min((size_t)slabsize, planes.size() - first);
+
+        for (size_t k = first; k < first + n; k++){
+            // Sum similarity of all source views at current plane
+            set_value(devSum.data(), 0.f, w, h, blocks, threads);
+            for (int i = 0; i < nimgs; i++){
+                if (src[i].levels > 1) warp_mipmapped(devWarped.data(), src[i], tables[i].H[k], w, h, blocks, threads);
+                else {
+                    transform_indexes(devx.data(), devy.data(), tables[i].H[k], w, h, blocks, threads);
+                    bilinear_interpolation(devWarped.data(), src[i].level[0],
+                                           devx.data(), devy.data(),
+                                           src[i].width[0], src[i].height[0], w, h,
+                                           blocks, threads);
+                }
+                cost.similarity(devSim.data(), deviceRef.data(), devWarped.data(), devx.data(), devy.data(), devInter1.data(),
+                                winsize, w, h, blocks, threads);
+                element_accumulate(devSum.data(), devSim.data(), w, h, blocks, threads);
+            }
+
+            // Encode plane into slab
+            unsigned char * out = devSlab.data() + (k - first) * planebytes;
+            if (encoding == CostVolume8U) encode_cost_uchar(out, devSum.data(), 1.f / nimgs, w, h, blocks, threads);
+            else encode_cost_half((unsigned short *)out, devSum.data(), 1.f / nimgs, w, h, blocks, threads);
+        }
+
+        // Pass slab to consumer
+        CHECK_CUDA_ERRORS_AUTO(cudaMemcpy(hostSlab.data(), devSlab.data(), n * planebytes, cudaMemcpyDeviceToHost));
+        sink(hostSlab.data(), first, n);
+    }
+}
+
+void PlaneSweep::SweepPruned(float *globDepth, float *globN, const float *Ref, const int nimgs)
+{
+    int w = HostRef.width(), h = HostRef.height();
+    int ncoarse = std::min((int)pruningsources, nimgs);
+    int ncand = std::max((int)pruningcandidates, 1);
+
+    ZNCCPolicy cost;
+    cost.prepareReference(Ref, winsize, stdthresh, w, h, blocks, threads);
+
+    GuidedFilter guide;
+    if (guidedfilter) guide.prepareGuide(Ref, guidedradius, guidedeps, w, h, blocks, threads);
+
+    // Create layered images holding candidate plane indexes and scores, sorted from best
+    Image<float> devIndex(w, h * ncand);
+    Image<float> devScore(w, h * ncand);
+    dim3 layerblocks(blocks.x, ceil(h * ncand/(float)threads.y));
+    set_value(devIndex.data(), -1.f, w, h * ncand, layerblocks, threads);
+    set_value(devScore.data(), -2.f, w, h * ncand, layerblocks, threads);
+
+    // Create intermediate images
+    Image<float> devNCC(w, h);
+    Image<float> devSum(w, h);
+    Image<float> devInter1(w, h);
+    Image<float> devx(w, h);
+    Image<float> devy(w, h);
+    Image<float> devWarped(w, h);
+
+    // Copy coarse source views to device and get their homographies, tables are copied since cache may evict them
+    std::vector<std::vector<Image<float>>> devSrc(ncoarse);
+    std::vector<MipLevels> src(ncoarse);
+    std::vector<HomographyTable> tables(ncoarse);
+    Matrix3D Rrel;
+    Vector3D trel;
+    for (int i = 0; i < ncoarse; i++){
+        src[i] = DeviceSourceLevels(i, devSrc[i], mipmapping ? MAX_MIP_LEVELS : 1);
+        RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, Source(i).R, Source(i).t);
+        tables[i] = homographies.getTable(Rrel, trel, K, invK, planes);
+    }
 
-        //-----------------------------------------------------
+    // Sweep all planes against coarse source views and keep best candidates of their average NCC
+    for (size_t k = 0; k < planes.size(); k++){
+        for (int i = 0; i < ncoarse; i++){
+            if (src[i].levels > 1) warp_mipmapped(devWarped.data(), src[i], tables[i].H[k], w, h, blocks, threads);
+            else {
+                transform_indexes(devx.data(), devy.data(), tables[i].H[k], w, h, blocks, threads);
+                bilinear_interpolation(devWarped.data(), src[i].level[0],
+                                       devx.data(), devy.data(),
+                                       src[i].width[0], src[i].height[0],
+                                       w, h, blocks, threads);
+            }
 
-        auto t2 = std::chrono::high_resolution_clock::now();
-        std::cout << "Time taken for the algorithm to complete is " <<
-                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
-        std::cout.flush();
+            cost.similarity(i ? devNCC.data() : devSum.data(), Ref, devWarped.data(), devx.data(), devy.data(),
+                            devInter1.data(), winsize, w, h, blocks, threads);
+            if (i) element_accumulate(devSum.data(), devNCC.data(), w, h, blocks, threads);
+        }
+        if (ncoarse > 1) element_scale(devSum.data(), 1.f / ncoarse, w, h, blocks, threads);
 
-        return true;
+        if (guidedfilter) guide.filter(devSum.data(), Ref, devx.data(), devy.data(), devWarped.data(), devInter1.data(),
+                                       w, h, blocks, threads);
 
+        candidates_insert(devIndex.data(), devScore.data(), devSum.data(), k, ncand, w, h, blocks, threads);
     }
-    catch(const std::exception& e)
-    {
-        std::cerr << "Exception caught: \n";
-        std::cerr << e.what() << std::endl;
 
-        cudaReset();
-        return false;
-    }
+    // Verify candidates with remaining source views, PATCHMATCH_MAX_SOURCES at a time. Candidate scores are averages
+    // weighted by number of source views they were scored with, coarse scores have weight of coarse source views.
+    Image<float> devWeight(w, h * ncand);
+    set_value(devWeight.data(), (float)ncoarse, w, h * ncand, layerblocks, threads);
+
+    Image<float> devPlanes(planes.size(), 1);
+    devPlanes.copyFrom(planes.data(), planes.size() * sizeof(float));
+
+    std::vector<Image<float>> devFine(PATCHMATCH_MAX_SOURCES);
+    PatchMatchParams params;
+    params.K = K;
+    params.invK = invK;
+    params.winsize = winsize;
+    params.stdthresh = stdthresh;
+    params.znear = znear;
+    params.zfar = zfar;
+    params.normals = false;
+
+    // Runs once even without remaining source views, so that best coarse candidates are selected
+    int first = ncoarse;
+    do {
+        params.nsrc = std::min(nimgs - first, PATCHMATCH_MAX_SOURCES);
+        for (int i = 0; i < params.nsrc; i++){
+            const CamImage<float> & source = Source(first + i);
+            RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, source.R, source.t);
+            params.Rrel[i] = Rrel;
+            params.trel[i] = make_float3(trel.x, trel.y, trel.z);
+            params.src[i] = DeviceSource(first + i, devFine[i]);
+            params.srcwidth[i] = source.width();
+            params.srcheight[i] = source.height();
+        }
 
-    return false;
+        candidates_verify(devx.data(), devNCC.data(), devIndex.data(), devScore.data(), devWeight.data(),
+                          devPlanes.data(), Ref, params, ncand, w, h, blocks, threads);
+        first += params.nsrc;
+    } while (first < nimgs);
+
+    sum_depthmap_NCC(globDepth, globN,
+                     devx.data(), devNCC.data(),
+                     nccthresh, w, h,
+                     blocks, threads);
 }
 
-void PlaneSweep::PlaneSweepThread(float *globDepth, float *globN, const float *Ref, const float *Refmean, const float *Refstd,
-                                  const unsigned int &index)
+void PlaneSweep::CalculatePlaneDepths(const int nimgs)
 {
-    int w = HostRef.width(), h = HostRef.height();
+    planes.clear();
 
-    // calculate depth step size:
-    float dstep = (zfar - znear) / (numberplanes - 1);
-
-    // Create image to store current source view
-    Image<float> devSrc(w, h);
+    // Custom distribution without planes falls back to uniform depth
+    if ((planedistribution == CustomPlanes) && !customplanes.empty()){
+        planes = customplanes;
+        return;
+    }
 
-    // Create matrices to hold homography and relative rotation and transformation
-    Matrix3D H, Rrel, tr;
-    Vector3D trel;
+    int n = std::max((int)numberplanes, 2);
 
-    // Create intermediate images to store current NCC, best NCC and current depthmap
-    Image<float> devNCC(w, h);
-    Image<float> devbestNCC(w, h);
-    Image<float> devDepth(w, h);
-    Image<float> devInter1(w, h);
+    if ((planedistribution == UniformDepth) || (planedistribution == CustomPlanes)){
+        float dstep = (zfar - znear) / (n - 1);
+        for (int i = 0; i < n; i++) planes.push_back(znear + i * dstep);
+        return;
+    }
 
-    // Create images to store x and y indexes after transformation
-    Image<float> devx(w, h);
-    Image<float> devy(w, h);
+    // Both remaining distributions are uniform in inverse depth
+    float inear = 1.f / znear, ifar = 1.f / zfar;
 
-    // Create image to hold pixel values after transformation
-    Image<float> devWarped(w, h);
+    if (planedistribution == UniformDisparity){
+        // Find the largest pixel shift per unit of inverse depth over all source views. Source pixel for reference
+        // pixel p at inverse depth q is given by (a + q * b) / (a.z + q * b.z), where a = K * Rrel * invK * p
+        // and b = K * trel * (invK * p).z, derivative is evaluated at image corners, center and both end planes
+        int w = HostRef.width(), h = HostRef.height();
+        Matrix3D Rrel;
+        Vector3D trel;
+        float rate = 0.f;
+
+        for (int i = 0; i < nimgs; i++){
+            RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, Source(i).R, Source(i).t);
+            Matrix3D A = K * Rrel * invK;
+            float3 kt = K * make_float3(trel.x, trel.y, trel.z);
+
+            for (int y = 0; y < 3; y++)
+                for (int x = 0; x < 3; x++){
+                    float3 p = make_float3(1 + x * (w - 1) / 2.f, 1 + y * (h - 1) / 2.f, 1.f);
+                    float3 a = A * p;
+                    float3 b = kt * (invK * p).z;
+                    for (int e = 0; e < 2; e++){
+                        float q = e == 0 ? inear : ifar;
+                        float z = a.z + q * b.z;
+                        if (z <= 0.f) continue;
+                        float2 dp = make_float2(b.x * a.z - a.x * b.z, b.y * a.z - a.y * b.z) / (z * z);
+                        rate = std::max(rate, length(dp));
+                    }
+                }
+        }
 
-    // Copy source view to device
-    devSrc.copyFrom(HostSrc[index]);
+        // Adjacent planes should be at most 1 pixel apart in the source view with the widest baseline
+        if (rate > 0.f) n = std::min(n, std::max((int)ceil(rate * (inear - ifar)) + 1, 2));
+    }
 
-    // Calculate relative rotation and translation:
-    RelativeMatrices(Rrel, trel, HostRef.R, HostRef.t, HostSrc[index].R, HostSrc[index].t);
-    tr.row(2) = trel;
-    tr = tr.trans();
+    // Order planes from near to far
+    float istep = (inear - ifar) / (n - 1);
+    for (int i = 0; i < n; i++) planes.push_back(1.f / (inear - i * istep));
+}
 
-    // For each depth calculate NCC and update depthmap as required
-    for (float d = znear; d <= zfar; d += dstep){
-        // Calculate homography:
-        H = K * (Rrel + tr / d) * invK;
-        H = H / H(2,2);
+uint64_t PlaneSweep::SourceMapsKey(const unsigned int index) const
+{
+    const CamImage<float> & src = Source(index);
+    int params[10] = { (int)src.width(), (int)src.height(), (int)winsize, (int)subplanerefinement,
+                       (int)alternativemethod, (int)planes.size(), (int)matchingcost,
+                       (int)guidedfilter, (int)guidedradius, (int)mipmapping };
+
+    // Views are identified by their generations, position in HostSrc and memory, not by their contents
+    uint64_t generations[2] = { refgeneration, sourcegeneration };
+    const void * identity[2] = { HostRef.data(), src.data() };
+    unsigned int position = SourceIndex(index);
+
+    uint64_t key = HashBytes(generations, sizeof(generations));
+    key = HashBytes(identity, sizeof(identity), key);
+    key = HashBytes(&position, sizeof(position), key);
+    key = HashBytes(params, sizeof(params), key);
+    key = HashBytes(&stdthresh, sizeof(stdthresh), key);
+    key = HashBytes(&guidedeps, sizeof(guidedeps), key);
+    key = HashBytes(planes.data(), planes.size() * sizeof(float), key);
+    key = HashBytes(&K, sizeof(Matrix3D), key);
+    key = HashBytes(&invK, sizeof(Matrix3D), key);
+    key = HashBytes(&HostRef.R, sizeof(Matrix3D), key);
+    key = HashBytes(&HostRef.t, sizeof(Vector3D), key);
+    key = HashBytes(&src.R, sizeof(Matrix3D), key);
+    return HashBytes(&src.t, sizeof(Vector3D), key);
+}
 
-        // Calculate transformed pixel coordinates
-        transform_indexes(devx.data(), devy.data(), H, w, h, blocks, threads);
+void PlaneSweep::StoreSourceMaps(const uint64_t key, const float *devDepth, const float *devbestNCC)
+{
+    int w = HostRef.width(), h = HostRef.height();
 
-        // interpolate pixel values:
-        bilinear_interpolation(devWarped.data(), devSrc.data(),
-                               devx.data(), devy.data(),
-                               devSrc.width(), devSrc.height(),
-                               devx.width(), devx.height(),
-                               blocks, threads);
+    // Remove least recently used entry if cache is full
+    if ((sourcemaps.size() >= MAX_CACHED_SOURCE_MAPS) && (sourcemaps.find(key) == sourcemaps.end())){
+        auto lru = sourcemaps.begin();
+        for (auto it = sourcemaps.begin(); it != sourcemaps.end(); ++it)
+            if (it->second.lastused < lru->second.lastused) lru = it;
+        sourcemaps.erase(lru);
+    }
 
-        // We have no more use for devx and devy, we can use them to store intermediate results now
-        // devx - will hold windowed mean of warped image
-        // devy - will hold windowed std of warped image
-        windowed_mean_column(devInter1.data(), devWarped.data(), winsize, false, w, h,
-                             blocks, threads);
-        windowed_mean_row(devx.data(), devInter1.data(), winsize, false, w, h,
-                          blocks, threads);
+    SourceMaps & maps = sourcemaps[key];
+    maps.lastused = runcount;
+    maps.dmin = planes.front();
+    maps.dmax = planes.back();
+    maps.depth.resize(w * h);
+    maps.ncc.resize(w * h);
+    Image<float, Standard>(maps.depth.data(), w, h).copyFrom(Image<float>((float *)devDepth, w, h));
+    Image<float, Standard>(maps.ncc.data(), w, h).copyFrom(Image<float>((float *)devbestNCC, w, h));
+
+    if (!compresssourcemaps){
+        maps.cdepth.clear();
+        maps.cncc.clear();
+        return;
+    }
 
-        windowed_mean_column(devy.data(), devWarped.data(), winsize, true, w, h,
-                             blocks, threads);
-        windowed_mean_row(devInter1.data(), devy.data(), winsize, false, w, h,
-                          blocks, threads);
+    // Quantize depth over plane depth range and NCC over [-1,1] to 16 bits
+    maps.cdepth.resize(w * h);
+    maps.cncc.resize(w * h);
+    float drange = std::max(maps.dmax - maps.dmin, 1e-6f);
+    for (int i = 0; i < w * h; i++){
+        float d = maps.depth[i], c = maps.ncc[i];
+        maps.cdepth[i] = (d == d) ? uint16_t(USHRT_MAX * std::min(std::max((d - maps.dmin) / drange, 0.f), 1.f) + .5f) : 0;
+        maps.cncc[i] = (c == c) ? int16_t(floor(SHRT_MAX * std::min(std::max(c, -1.f), 1.f) + .5f)) : SHRT_MIN;
+    }
+    std::vector<float>().swap(maps.depth);
+    std::vector<float>().swap(maps.ncc);
+}
 
-        calculate_STD(devy.data(), devx.data(), devInter1.data(),
-                      w, h, blocks, threads);
+bool PlaneSweep::RestoreSourceMaps(const uint64_t key, float *devDepth, float *devbestNCC)
+{
+    auto it = sourcemaps.find(key);
+    if (it == sourcemaps.end()) return false;
 
-        // calculate NCC for each window which is given by
-        // NCC = (mean of products - product of means) / product of standard deviations
-        element_multiply(devInter1.data(), Ref, devWarped.data(), w, h, blocks, threads);
-        windowed_mean_column(devWarped.data(), devInter1.data(), winsize, false, w, h,
-                             blocks, threads);
-        windowed_mean_row(devInter1.data(), devWarped.data(), winsize, false, w, h,
-                          blocks, threads);
-        calcNCC(devNCC.data(), devInter1.data(),
-                Refmean, devx.data(),
-                Refstd, devy.data(),
-                stdthresh, stdthresh,
-                w, h,
-                blocks, threads);
+    int w = HostRef.width(), h = HostRef.height();
+    SourceMaps & maps = it->second;
+    maps.lastused = runcount;
+
+    if (maps.depth.empty()){
+        // Decompress entry
+        std::vector<float> depth(w * h), ncc(w * h);
+        float drange = maps.dmax - maps.dmin;
+        for (int i = 0; i < w * h; i++){
+            depth[i] = maps.dmin + drange * maps.cdepth[i] / USHRT_MAX;
+            ncc[i] = std::max(maps.cncc[i] / (float)SHRT_MAX, -1.f);
+        }
+        Image<float>(devDepth, w, h).copyFrom(Image<float, Standard>(depth.data(), w, h));
+        Image<float>(devbestNCC, w, h).copyFrom(Image<float, Standard>(ncc.data(), w, h));
+    }
+    else {
+        Image<float>(devDepth, w, h).copyFrom(Image<float, Standard>(maps.depth.data(), w, h));
+        Image<float>(devbestNCC, w, h).copyFrom(Image<float, Standard>(maps.ncc.data(), w, h));
+    }
 
-        // only keep depth and bestncc values for which best ncc is greater than current
-        // set other values to current ncc and depth
-        update_arrays(devDepth.data(), devbestNCC.data(),
-                      devNCC.data(), d, w, h,
-                      blocks, threads);
+    return true;
+}
 
+bool PlaneSweep::setCustomPlanes(const std::vector<float> & depths)
+{
+    std::vector<float> valid;
+    for (size_t i = 0; i < depths.size(); i++)
+        if (depths[i] > 0.f) valid.push_back(depths[i]);
+    if (valid.empty()){
+        std::cerr << "No valid custom plane depths given, plane distribution is not changed\n";
+        return false;
     }
 
-    sum_depthmap_NCC(globDepth, globN,
-                     devDepth.data(), devbestNCC.data(),
-                     nccthresh, w, h,
-                     blocks, threads);
+    std::sort(valid.begin(), valid.end());
+    valid.erase(std::unique(valid.begin(), valid.end()), valid.end());
+    customplanes = valid;
 
-    return;
+    planedistribution = CustomPlanes;
+    numberplanes = customplanes.size();
+    znear = customplanes.front();
+    zfar = customplanes.back();
+    return true;
 }
 
 bool PlaneSweep::Denoise(unsigned int niter, double lambda)
@@ -276,16 +1765,204 @@ bool PlaneSweep::Denoise(unsigned int niter, double lambda)
     return false;
 }
 
+bool PlaneSweep::CpuDenoise(const unsigned int niters, const double lambda, const double tau, const double sigma,
+                            const double theta, const double beta, const double gamma)
+{
+    if (!depthavailable) return false;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    printf("Starting CPU TVL1 denoising...\n\n");
+
+    int w = depthmap.width(), h = depthmap.height();
+    depthmapdenoised.reset(w, h);
+    depthmap8udenoised.reset(w, h);
+
+    // Normalize depth and scale input the same way as in CudaDenoise()
+    std::vector<float> ref(w * h), rawInput(w * h);
+    float * u = depthmapdenoised.data();
+    for (int i = 0; i < w * h; i++){
+        ref[i] = HostRef.data()[i] / 255.f;
+        u[i] = (depthmap.data()[i] - znear) / (zfar - znear);
+        rawInput[i] = -sigma * u[i];
+    }
+
+    TVL1Solver solver(w, h);
+    solver.setTensor(ref.data(), beta, gamma);
+    solver.solve(u, rawInput.data(), niters, lambda, tau, sigma, theta);
+
+    for (int i = 0; i < w * h; i++) u[i] = u[i] * (zfar - znear) + znear;
+    ConvertDepthtoUChar(depthmapdenoised, depthmap8udenoised);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::cout << "Time taken for the CPU TVL1 denoising to complete is " <<
+                 std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+    std::cout.flush();
+
+    return true;
+}
+
+bool PlaneSweep::CpuDenoiseBatch(const std::vector<CamImage<float>> &depthmaps, std::vector<CamImage<float>> &denoised,
+                                 const unsigned int niters, const double lambda, const double tau, const double sigma,
+                                 const double theta, const double beta, const double gamma)
+{
+    const std::vector<const CamImage<float> *> guides(1, &HostRef);
+    return DenoiseBatchGuided(depthmaps, guides, denoised, niters, lambda, tau, sigma, theta, beta, gamma);
+}
+
+bool PlaneSweep::CpuDenoiseBatch(const std::vector<CamImage<float>> &depthmaps,
+                                 const std::vector<CamImage<float>> &guides, std::vector<CamImage<float>> &denoised,
+                                 const unsigned int niters, const double lambda, const double tau, const double sigma,
+                                 const double theta, const double beta, const double gamma)
+{
+    std::vector<const CamImage<float> *> pguides(guides.size());
+    for (size_t g = 0; g < guides.size(); g++) pguides[g] = &guides[g];
+    return DenoiseBatchGuided(depthmaps, pguides, denoised, niters, lambda, tau, sigma, theta, beta, gamma);
+}
+
+bool PlaneSweep::DenoiseBatchGuided(const std::vector<CamImage<float>> &depthmaps,
+                                    const std::vector<const CamImage<float> *> &guides,
+                                    std::vector<CamImage<float>> &denoised, const unsigned int niters,
+                                    const double lambda, const double tau, const double sigma, const double theta,
+                                    const double beta, const double gamma)
+{
+    if (depthmaps.empty() || guides.empty()) return false;
+    int w = guides[0]->width(), h = guides[0]->height();
+    if (w * h == 0) return false;
+
+    // Depthmaps are grouped by guide of the same camera pose, tensor of a guide is valid only for its own view
+    std::vector<std::vector<size_t>> groups(guides.size());
+    for (size_t i = 0; i < depthmaps.size(); i++){
+        const CamImage<float> & d = depthmaps[i];
+        if (((int)d.width() != w) || ((int)d.height() != h)){
+            std::cerr << "Depthmaps of the batch must have the size of reference image" << std::endl;
+            return false;
+        }
+
+        size_t g = 0;
+        while ((g < guides.size()) && ((memcmp(&guides[g]->R, &d.R, sizeof(Matrix3D)) != 0) ||
+                                       (memcmp(&guides[g]->t, &d.t, sizeof(Vector3D)) != 0))) g++;
+        if (g == guides.size()){
+            std::cerr << "Depthmaps of the batch must have the camera pose of their reference image" << std::endl;
+            return false;
+        }
+        if (((int)guides[g]->width() != w) || ((int)guides[g]->height() != h)){
+            std::cerr << "Reference images of the batch must have the same size" << std::endl;
+            return false;
+        }
+        groups[g].push_back(i);
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    printf("Starting CPU TVL1 batch denoising...\n\n");
+
+    // Output images are allocated in place, so vector must not grow afterwards
+    denoised.resize(depthmaps.size());
+    for (size_t i = 0; i < depthmaps.size(); i++){
+        denoised[i].reset(w, h);
+        denoised[i].R = depthmaps[i].R;
+        denoised[i].t = depthmaps[i].t;
+    }
+
+    size_t largest = 0;
+    for (const auto & group : groups) largest = std::max(largest, group.size());
+
+    const unsigned int lanes = std::min((size_t)TVL1_BATCH_LANES, largest);
+    TVL1BatchSolver solver(w, h, lanes);
+
+    std::vector<float> ref(w * h);
+    std::vector<float> u(w * h * lanes), rawInput(w * h * lanes);
+    std::vector<float> lambdas(lanes, lambda), taus(lanes, tau), sigmas(lanes, sigma), thetas(lanes, theta);
+    std::vector<const float *> inputs(lanes);
+    std::vector<float *> outputs(lanes);
+
+    for (size_t g = 0; g < guides.size(); g++){
+        const std::vector<size_t> & group = groups[g];
+        if (group.empty()) continue;
+
+        for (int i = 0; i < w * h; i++) ref[i] = guides[g]->data()[i] / 255.f;
+        solver.setTensor(ref.data(), beta, gamma);
+
+        for (size_t b = 0; b < group.size(); b += lanes){
+            // Unused lanes of last batch of the group repeat its first depthmap
+            for (unsigned int k = 0; k < lanes; k++){
+                const size_t j = b + k < group.size() ? group[b + k] : group[b];
+                inputs[k] = depthmaps[j].data();
+                outputs[k] = denoised[j].data();
+            }
+
+            // Normalize depth and scale input the same way as in CpuDenoise()
+            solver.interleave(u.data(), inputs.data());
+            for (size_t i = 0; i < u.size(); i++){
+                u[i] = (u[i] - znear) / (zfar - znear);
+                rawInput[i] = -sigma * u[i];
+            }
+
+            solver.solve(u.data(), rawInput.data(), niters, lambdas.data(), taus.data(), sigmas.data(), thetas.data());
+
+            for (size_t i = 0; i < u.size(); i++) u[i] = u[i] * (zfar - znear) + znear;
+            solver.deinterleave(outputs.data(), u.data());
+        }
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::cout << "Time taken for the CPU TVL1 denoising of " << depthmaps.size() << " depthmaps to complete is " <<
+                 std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+    std::cout.flush();
+
+    return true;
+}
+
+bool PlaneSweep::MedianDenoise(unsigned int radius, unsigned int passes)
+{
+    if (!depthavailable) return false;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    int w = depthmap.width(), h = depthmap.height();
+    depthmapdenoised.reset(w, h);
+    depthmap8udenoised.reset(w, h);
+
+    // Quantize depth the same way as 8 bit depthmaps
+    MedianFilter median(w, h);
+    median.setRadius(radius);
+    median.setRange(znear, zfar, (planedistribution == UniformInverseDepth) || (planedistribution == UniformDisparity));
+
+    median.compute(depthmapdenoised.data(), depthmap.data());
+    if (passes > 1){
+        std::vector<float> temp(w * h);
+        for (unsigned int i = 1; i < passes; i++){
+            std::copy(depthmapdenoised.data(), depthmapdenoised.data() + w * h, temp.begin());
+            median.compute(depthmapdenoised.data(), temp.data());
+        }
+    }
+
+    ConvertDepthtoUChar(depthmapdenoised, depthmap8udenoised);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::cout << "Time taken for the median filtering to complete is " <<
+                 std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+    std::cout.flush();
+
+    return true;
+}
+
 void PlaneSweep::ConvertDepthtoUChar(const CamImage<float>& input, CamImage<uchar>& output)
 {
     output.reset(input.width(), input.height());
+
+    // Planes spaced in inverse depth are quantized in inverse depth as well so each level covers the same number of planes
+    bool inverse = (planedistribution == UniformInverseDepth) || (planedistribution == UniformDisparity);
+    float inear = 1.f / znear, ifar = 1.f / zfar;
+
     for (size_t x = 0; x < input.width(); ++x)
         for (size_t y = 0; y < input.height(); ++y)
         {
             int i = x + y * input.width();
+            float d = input.data()[i];
             // Check if QNAN
-            if (input.data()[i] == input.data()[i]) output.data()[i] = uchar(UCHAR_MAX * std::min(std::max((input.data()[i] - znear) / (zfar - znear), 0.f), 1.f));
-            else output.data()[i] = UCHAR_MAX;
+            if (d != d) output.data()[i] = UCHAR_MAX;
+            else if (inverse) output.data()[i] = uchar(UCHAR_MAX * std::min(std::max((inear - 1.f / std::max(d, znear)) / (inear - ifar), 0.f), 1.f));
+            else output.data()[i] = uchar(UCHAR_MAX * std::min(std::max((d - znear) / (zfar - znear), 0.f), 1.f));
         }
 }
 
@@ -310,10 +1987,7 @@ bool PlaneSweep::CudaDenoise(int argc, char ** argv, const unsigned int niters,
         }
 
         int h = depthmap.height(), w = depthmap.width();
-        CHECK_CUDA_ERRORS_AUTO(cudaFree(d_depthmap));
-
-        size_t pitch;
-        CHECK_CUDA_ERRORS_AUTO(cudaMallocPitch(&d_depthmap, &pitch, w * sizeof(float), h));
+        size_t pitch = DeviceDepthmap(w, h);
 
         if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
         blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
@@ -325,15 +1999,11 @@ bool PlaneSweep::CudaDenoise(int argc, char ** argv, const unsigned int niters,
         Image<float> Px(w,h);
         Image<float> Py(w,h);
         Image<float> rawInput(w,h);
-        Image<float> T11(w,h), T12(w,h), T21(w,h), T22(w,h), ref(w,h);
+        const std::vector<Image<float>> & T = DeviceTensor(beta, gamma);
 
-        ref.copyFrom(HostRef);
         CHECK_CUDA_ERRORS_AUTO(cudaMemcpy2D(d_depthmap, pitch, depthmap.data(), depthmap.pitch(), w * sizeof(float), h, cudaMemcpyHostToDevice));
         rawInput.copyFrom(depthmap);
 
-        element_scale(ref.data(), 1/255.f, w, h, blocks, threads);
-        Anisotropic_diffusion_tensor(T11.data(), T12.data(), T21.data(), T22.data(), ref.data(), beta, gamma, w, h, blocks, threads);
-
         element_add(d_depthmap, -znear, w, h, blocks, threads);
         element_add(rawInput.data(), -znear, w, h, blocks, threads);
 
@@ -343,14 +2013,11 @@ bool PlaneSweep::CudaDenoise(int argc, char ** argv, const unsigned int niters,
         element_scale(d_depthmap, xscale, w, h, blocks, threads);
         element_scale(rawInput.data(), inputscale, w, h, blocks, threads);
 
-        for (unsigned int i = 0; i < niters; i++){
-            double currsigma = i == 0 ? 1 + sigma : sigma;
-            denoising_TVL1_calculateP_tensor_weighed(Px.data(), Py.data(), T11.data(), T12.data(), T21.data(), T22.data(),
-                                                     d_depthmap, currsigma, w, h, blocks, threads);
-            denoising_TVL1_update(d_depthmap, R.data(), Px.data(), Py.data(), rawInput.data(),
-                                  tau, theta, lambda, sigma,
-                                  w, h, blocks, threads);
-        }
+        tvl1iterations = TVL1Iterations(d_depthmap, R.data(), Px.data(), Py.data(), rawInput.data(),
+                                        T[0].data(), T[1].data(), T[2].data(), T[3].data(),
+                                        niters, lambda, tau, sigma, theta, true, w, h);
+        if ((tvl1tolerance > 0) && (tvl1checkinterval > 0))
+            std::cout << "TVL1 denoising used " << tvl1iterations << " of " << niters << " iterations\n";
 
         element_scale(d_depthmap, (zfar - znear), w, h, blocks, threads);
         element_add(d_depthmap, znear, w, h, blocks, threads);
@@ -378,6 +2045,254 @@ bool PlaneSweep::CudaDenoise(int argc, char ** argv, const unsigned int niters,
     return false;
 }
 
+unsigned int PlaneSweep::TVL1Iterations(float *u, float *R, float *Px, float *Py, const float *rawInput,
+                                        const float *T11, const float *T12, const float *T21, const float *T22,
+                                        const unsigned int niters, const double lambda, const double tau,
+                                        const double sigma, const double theta, const bool coldstart,
+                                        const int w, const int h)
+{
+    dim3 levelblocks(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+
+    // Relative change of u is summed on every check iteration when tolerance is set
+    Image<float> change;
+    bool tolerance = (tvl1tolerance > 0) && (tvl1checkinterval > 0);
+    if (tolerance) change.reset(2, 1);
+
+    for (unsigned int i = 0; i < niters; i++){
+        double currsigma = coldstart && (i == 0) ? 1 + sigma : sigma;
+        denoising_TVL1_calculateP_tensor_weighed(Px, Py, T11, T12, T21, T22,
+                                                 u, currsigma, w, h, levelblocks, threads);
+
+        if (tolerance && ((i + 1) % tvl1checkinterval == 0)){
+            float sums[2];
+            CHECK_CUDA_ERRORS_AUTO(cudaMemset(change.data(), 0, 2 * sizeof(float)));
+            denoising_TVL1_update_change(u, R, Px, Py, rawInput, change.data(),
+                                         tau, theta, lambda, sigma,
+                                         w, h, levelblocks, threads);
+            CHECK_CUDA_ERRORS_AUTO(cudaMemcpy(sums, change.data(), 2 * sizeof(float), cudaMemcpyDeviceToHost));
+            if (sqrt(sums[0]) <= tvl1tolerance * sqrt(sums[1])) return i + 1;
+        }
+        else denoising_TVL1_update(u, R, Px, Py, rawInput,
+                                   tau, theta, lambda, sigma,
+                                   w, h, levelblocks, threads);
+    }
+
+    return niters;
+}
+
+bool PlaneSweep::CudaDenoiseMultiscale(int argc, char **argv, const unsigned int levels, const unsigned int coarseiters,
+                                       const unsigned int fineiters, const double lambda, const double tau,
+                                       const double sigma, const double theta, const double beta, const double gamma)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+    printf("Starting multiscale TVL1 denoising...\n\n");
+
+    if (depthavailable) try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        int h = depthmap.height(), w = depthmap.width();
+        size_t pitch = DeviceDepthmap(w, h);
+
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+        blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+
+        depthmapdenoised.reset(w, h);
+        depthmap8udenoised.reset(w, h);
+
+        // Level sizes, each next level has half the size
+        std::vector<int> lw(1, w), lh(1, h);
+        while ((lw.size() < std::max(levels, 1u)) && (lw.back() / 2 >= MIN_MIP_SIZE) && (lh.back() / 2 >= MIN_MIP_SIZE)){
+            lw.push_back(lw.back() / 2);
+            lh.push_back(lh.back() / 2);
+        }
+        int L = lw.size();
+
+        // Images are allocated in place, so vectors must not grow afterwards
+        std::vector<Image<float>> input(L), ref(L), u(L), R(L), Px(L), Py(L);
+        for (int l = 0; l < L; l++){
+            input[l].reset(lw[l], lh[l]);
+            ref[l].reset(lw[l], lh[l]);
+            u[l].reset(lw[l], lh[l]);
+            R[l].reset(lw[l], lh[l]);
+            Px[l].reset(lw[l], lh[l]);
+            Py[l].reset(lw[l], lh[l]);
+        }
+
+        // Normalized depth and reference image pyramids
+        input[0].copyFrom(depthmap);
+        element_add(input[0].data(), -znear, w, h, blocks, threads);
+        element_scale(input[0].data(), 1.f/(zfar - znear), w, h, blocks, threads);
+        ref[0].copyFrom(HostRef);
+        element_scale(ref[0].data(), 1/255.f, w, h, blocks, threads);
+        for (int l = 1; l < L; l++){
+            dim3 levelblocks(ceil(lw[l]/(float)threads.x), ceil(lh[l]/(float)threads.y));
+            downsample(input[l].data(), input[l - 1].data(), lw[l - 1], lh[l - 1], lw[l], lh[l], levelblocks, threads);
+            downsample(ref[l].data(), ref[l - 1].data(), lw[l - 1], lh[l - 1], lw[l], lh[l], levelblocks, threads);
+        }
+
+        // Coarsest level starts from input, finer levels start from prolongated primal and dual variables
+        tvl1iterations = 0;
+        for (int l = L - 1; l >= 0; l--){
+            int cw = lw[l], ch = lh[l];
+            dim3 levelblocks(ceil(cw/(float)threads.x), ceil(ch/(float)threads.y));
+
+            if (l == L - 1){
+                u[l].copyFrom(input[l]);
+                set_value(R[l].data(), 0.f, cw, ch, levelblocks, threads);
+                set_value(Px[l].data(), 0.f, cw, ch, levelblocks, threads);
+                set_value(Py[l].data(), 0.f, cw, ch, levelblocks, threads);
+            }
+            else {
+                upsample(u[l].data(), u[l + 1].data(), lw[l + 1], lh[l + 1], cw, ch, levelblocks, threads);
+                upsample(R[l].data(), R[l + 1].data(), lw[l + 1], lh[l + 1], cw, ch, levelblocks, threads);
+                upsample(Px[l].data(), Px[l + 1].data(), lw[l + 1], lh[l + 1], cw, ch, levelblocks, threads);
+                upsample(Py[l].data(), Py[l + 1].data(), lw[l + 1], lh[l + 1], cw, ch, levelblocks, threads);
+            }
+
+            Image<float> rawInput(cw, ch);
+            rawInput.copyFrom(input[l]);
+            element_scale(rawInput.data(), -sigma, cw, ch, levelblocks, threads);
+
+            // Full resolution uses cached tensor, coarse levels calculate their own
+            std::vector<Image<float>> levelT(l == 0 ? 0 : 4);
+            for (auto & T : levelT) T.reset(cw, ch);
+            if (l > 0) Anisotropic_diffusion_tensor(levelT[0].data(), levelT[1].data(), levelT[2].data(), levelT[3].data(),
+                                                    ref[l].data(), beta, gamma, cw, ch, levelblocks, threads);
+            const std::vector<Image<float>> & T = l == 0 ? DeviceTensor(beta, gamma) : levelT;
+
+            tvl1iterations += TVL1Iterations(u[l].data(), R[l].data(), Px[l].data(), Py[l].data(), rawInput.data(),
+                                             T[0].data(), T[1].data(), T[2].data(), T[3].data(),
+                                             l == 0 ? fineiters : coarseiters, lambda, tau, sigma, theta, l == L - 1,
+                                             cw, ch);
+        }
+
+        element_scale(u[0].data(), (zfar - znear), w, h, blocks, threads);
+        element_add(u[0].data(), znear, w, h, blocks, threads);
+
+        CHECK_CUDA_ERRORS_AUTO(cudaMemcpy2D(d_depthmap, pitch, u[0].data(), u[0].pitch(), w * sizeof(float), h, cudaMemcpyDeviceToDevice));
+        CHECK_CUDA_ERRORS_AUTO(cudaMemcpy2D(depthmapdenoised.data(), depthmapdenoised.pitch(), d_depthmap, pitch, w * sizeof(float), h, cudaMemcpyDeviceToHost));
+        ConvertDepthtoUChar(depthmapdenoised, depthmap8udenoised);
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Time taken for the multiscale TVL1 denoising to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Exception caught: ";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
+bool PlaneSweep::CudaDenoiseUpdate(int argc, char **argv, const unsigned int niters, const unsigned int updateiters,
+                                   const double lambda, const double tau, const double sigma, const double theta,
+                                   const double beta, const double gamma)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+    printf("Starting TVL1 denoising update...\n\n");
+
+    if (depthavailable) try
+    {
+        if (cudaDevInit(argc, (const char **)argv) == NO_CUDA_DEVICE)
+        {
+            cudaReset();
+            return false;
+        }
+
+        int h = depthmap.height(), w = depthmap.width();
+        size_t pitch = DeviceDepthmap(w, h);
+
+        if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
+        blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
+
+        if (((int)depthmapdenoised.width() != w) || ((int)depthmapdenoised.height() != h)) depthmapdenoised.reset(w, h);
+        if (((int)depthmap8udenoised.width() != w) || ((int)depthmap8udenoised.height() != h)) depthmap8udenoised.reset(w, h);
+
+        // Kept state is valid while depthmap and its depth range have not changed
+        float range[2] = {znear, zfar};
+        int size[2] = {w, h};
+        uint64_t key = HashBytes(&depthgeneration, sizeof(depthgeneration));
+        key = HashBytes(size, sizeof(size), key);
+        key = HashBytes(range, sizeof(range), key);
+
+        bool coldstart = (key != tvl1statekey) || (tvl1state.size() != TVL1StateCount) || !tvl1state[TVL1Input].isValid();
+        if (coldstart){
+            // State images are allocated in place, so vector must not grow afterwards
+            tvl1state.resize(TVL1StateCount);
+            for (auto & img : tvl1state) img.reset(w, h);
+
+            tvl1state[TVL1Input].copyFrom(depthmap);
+            element_add(tvl1state[TVL1Input].data(), -znear, w, h, blocks, threads);
+            element_scale(tvl1state[TVL1Input].data(), 1.f/(zfar - znear), w, h, blocks, threads);
+            tvl1state[TVL1U].copyFrom(tvl1state[TVL1Input]);
+            set_value(tvl1state[TVL1R].data(), 0.f, w, h, blocks, threads);
+            set_value(tvl1state[TVL1Px].data(), 0.f, w, h, blocks, threads);
+            set_value(tvl1state[TVL1Py].data(), 0.f, w, h, blocks, threads);
+            tvl1statekey = key;
+        }
+
+        // Data term depends on sigma, so it is rescaled on every update
+        tvl1state[TVL1RawInput].copyFrom(tvl1state[TVL1Input]);
+        element_scale(tvl1state[TVL1RawInput].data(), -sigma, w, h, blocks, threads);
+
+        const std::vector<Image<float>> & T = DeviceTensor(beta, gamma);
+
+        unsigned int iters = coldstart ? niters : updateiters;
+        tvl1iterations = TVL1Iterations(tvl1state[TVL1U].data(), tvl1state[TVL1R].data(),
+                                        tvl1state[TVL1Px].data(), tvl1state[TVL1Py].data(), tvl1state[TVL1RawInput].data(),
+                                        T[0].data(), T[1].data(), T[2].data(), T[3].data(),
+                                        iters, lambda, tau, sigma, theta, coldstart, w, h);
+        std::cout << "TVL1 denoising " << (coldstart ? "cold" : "warm") << " start used " << tvl1iterations
+                  << " of " << iters << " iterations\n";
+
+        CHECK_CUDA_ERRORS_AUTO(cudaMemcpy2D(d_depthmap, pitch, tvl1state[TVL1U].data(), tvl1state[TVL1U].pitch(),
+                                            w * sizeof(float), h, cudaMemcpyDeviceToDevice));
+        element_scale(d_depthmap, (zfar - znear), w, h, blocks, threads);
+        element_add(d_depthmap, znear, w, h, blocks, threads);
+
+        CHECK_CUDA_ERRORS_AUTO(cudaMemcpy2D(depthmapdenoised.data(), depthmapdenoised.pitch(), d_depthmap, pitch, w * sizeof(float), h, cudaMemcpyDeviceToHost));
+        ConvertDepthtoUChar(depthmapdenoised, depthmap8udenoised);
+
+        // Check for kernel errors
+        CHECK_CUDA_ERRORS_AUTO(cudaPeekAtLastError());
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "Time taken for the TVL1 denoising update to complete is " <<
+                     std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count() << "ms\n\n";
+        std::cout.flush();
+
+        return true;
+
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Exception caught: ";
+        std::cerr << e.what() << std::endl;
+
+        cudaReset();
+        return false;
+    }
+
+    return false;
+}
+
 bool PlaneSweep::TGV(int argc, char **argv, const unsigned int niters, const unsigned int warps, const double lambda,
                      const double alpha0, const double alpha1, const double tau, const double sigma, const double beta, const double gamma)
 {
@@ -403,10 +2318,9 @@ bool PlaneSweep::TGV(int argc, char **argv, const unsigned int niters, const uns
         // Initialize data images:
         Image<float> Ref(w,h), Px(w,h), Py(w,h), u(w,h), u0(w,h), u1x(w,h), u1y(w,h), ubar(w,h),
                 u1xbar(w,h), u1ybar(w,h), qx(w,h), qy(w,h), qz(w,h), qw(w,h), prodsum(w,h),
-                x(w,h), y(w,h), X(w,h), Y(w,h), Z(w,h), dX(w,h), dY(w,h), dZ(w,h), dfx(w,h), dfy(w,h),
-                T1(w,h), T2(w,h), T3(w,h), T4(w,h);
+                x(w,h), y(w,h), X(w,h), Y(w,h), Z(w,h), dX(w,h), dY(w,h), dZ(w,h), dfx(w,h), dfy(w,h);
 
-        int nimages = std::min(std::max((int)numberimages, 1), (int)HostSrc.size());
+        int nimages = SourceCount();
 
         std::vector<Image<float>> Src(nimages), It(nimages), Iu(nimages), r(nimages);
 
@@ -417,7 +2331,8 @@ bool PlaneSweep::TGV(int argc, char **argv, const unsigned int niters, const uns
         // Copy reference image to device memory and normalize
         Ref.copyFrom(HostRef);
         element_scale(Ref.data(), 1/255.f, w, h, blocks, threads);
-        Anisotropic_diffusion_tensor(T1.data(), T2.data(), T3.data(), T4.data(), Ref.data(), beta, gamma, w, h, blocks, threads);
+        const std::vector<Image<float>> & T = DeviceTensor(beta, gamma);
+        const Image<float> & T1 = T[0], & T2 = T[1], & T3 = T[2], & T4 = T[3];
 
         // Matrix storages:
         std::vector<Matrix3D> Rrel(nimages);
@@ -432,11 +2347,11 @@ bool PlaneSweep::TGV(int argc, char **argv, const unsigned int niters, const uns
             Iu[i].reset(w,h);
 
             // Copy source image to device memory and normalize
-            Src[i].copyFrom(HostSrc[i]);
+            Src[i].copyFrom(Source(i));
             element_scale(Src[i].data(), 1/255.f, w, h, blocks, threads);
 
             // Calculate relative rotation and translation
-            RelativeMatrices(Rrel[i], Trel[i], HostRef.R, HostRef.t, HostSrc[i].R, HostSrc[i].t);
+            RelativeMatrices(Rrel[i], Trel[i], HostRef.R, HostRef.t, Source(i).R, Source(i).t);
         }
 
         for (int l = 0; l < warps; l++){
@@ -587,10 +2502,24 @@ void PlaneSweep::get3Dcoordinates(CamImage<float> *&x, CamImage<float> *&y, CamI
 
 void PlaneSweep::cudaReset()
 {
+    // shared device memory has to be freed before reset
+    devicesources.clear();
+    devicetensor.clear();
+    tensorkey = 0;
+    tvl1state.clear();
+    tvl1statekey = 0;
+    devfilterstate.free();
+    devfilterkeyframe.free();
+    devfilterframe.free();
+    devfilterlists.clear();
+    devfiltercount.free();
+    filteractive = 0;
+
     CHECK_CUDA_ERRORS_AUTO(cudaDeviceReset());
 
     // set pointers to NULL so cudaFree will not try to free wrong memory
     d_depthmap = 0;
+    d_depthmapw = d_depthmaph = 0;
 }
 
 bool PlaneSweep::TGVdenoiseFromSparse(int argc, char **argv, const CamImage<float> &depth, const unsigned int niters,
@@ -613,12 +2542,9 @@ bool PlaneSweep::TGVdenoiseFromSparse(int argc, char **argv, const CamImage<floa
         depthmapTGV.reset(w, h);
 
         Image<float> px(w,h), py(w,h), qx(w,h), qy(w,h), qz(w,h), qw(w,h), /*u(w,h),*/ ubar(w,h),
-                vx(w,h), vy(w,h), vxbar(w,h), vybar(w,h), weights(w,h), Ds(w,h), ref(w,h), T1(w,h), T2(w,h), T3(w,h), T4(w,h);
+                vx(w,h), vy(w,h), vxbar(w,h), vybar(w,h), weights(w,h), Ds(w,h);
 
-        CHECK_CUDA_ERRORS_AUTO(cudaFree(d_depthmap));
-
-        size_t pitch;
-        CHECK_CUDA_ERRORS_AUTO(cudaMallocPitch(&d_depthmap, &pitch, w * sizeof(float), h));
+        size_t pitch = DeviceDepthmap(w, h);
 
         if (threads.x * threads.y == 0) threads = dim3(DEFAULT_BLOCK_XDIM, maxThreadsPerBlock/DEFAULT_BLOCK_XDIM);
         blocks = dim3(ceil(w/(float)threads.x), ceil(h/(float)threads.y));
@@ -631,10 +2557,8 @@ bool PlaneSweep::TGVdenoiseFromSparse(int argc, char **argv, const CamImage<floa
         //        ubar = u;
         CHECK_CUDA_ERRORS_AUTO(cudaMemcpy2D(d_depthmap, pitch, ubar.data(), ubar.pitch(), w * sizeof(float), h, cudaMemcpyDeviceToDevice));
 
-        ref.copyFrom(HostRef);
-        element_scale(ref.data(), 1.f / 255.f, w, h, blocks, threads);
-
-        Anisotropic_diffusion_tensor(T1.data(), T2.data(), T3.data(), T4.data(), ref.data(), beta, gamma, w, h, blocks, threads);
+        const std::vector<Image<float>> & T = DeviceTensor(beta, gamma);
+        const Image<float> & T1 = T[0], & T2 = T[1], & T3 = T[2], & T4 = T[3];
         //        set_value(T1.data(), 1.f, w, h, blocks, threads);
         //        set_value(T3.data(), 1.f, w, h, blocks, threads);
 
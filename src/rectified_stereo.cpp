@@ -0,0 +1,147 @@
+#include "rectified_stereo.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <cmath>
+
+RectifiedStereo::RectifiedStereo(unsigned int width, unsigned int height) :
+    w(width), h(height),
+    refmean(width * height), refstd(width * height), srcmean(width * height), srcstd(width * height),
+    best(width * height), below(width * height), above(width * height), prev(width * height),
+    bestd(width * height), prevd(width * height)
+{
+}
+
+void RectifiedStereo::windowStats(float *mean, float *std, const float *img) const
+{
+    const int W = w, H = h, n = (2 * r + 1) * (2 * r + 1);
+    std::fill(mean, mean + W * H, 0.f);
+    std::fill(std, std + W * H, 0.f);
+    if ((W <= 2 * r) || (H <= 2 * r)) return;
+
+    // Running column sums over window rows, running row sums over window columns
+    std::vector<double> col(W, 0.0), col2(W, 0.0);
+    for (int y = 0; y < 2 * r; y++)
+        for (int x = 0; x < W; x++){
+            col[x] += img[y * W + x];
+            col2[x] += img[y * W + x] * img[y * W + x];
+        }
+
+    for (int y = r; y < H - r; y++){
+        const float * add = img + (y + r) * W;
+        for (int x = 0; x < W; x++){
+            col[x] += add[x];
+            col2[x] += add[x] * add[x];
+        }
+
+        double s = 0.0, s2 = 0.0;
+        for (int x = 0; x < 2 * r; x++){
+            s += col[x];
+            s2 += col2[x];
+        }
+        for (int x = r; x < W - r; x++){
+            s += col[x + r];
+            s2 += col2[x + r];
+            const double m = s / n;
+            mean[y * W + x] = m;
+            std[y * W + x] = std::sqrt(std::max(s2 / n - m * m, 0.0));
+            s -= col[x - r];
+            s2 -= col2[x - r];
+        }
+
+        const float * sub = img + (y - r) * W;
+        for (int x = 0; x < W; x++){
+            col[x] -= sub[x];
+            col2[x] -= sub[x] * sub[x];
+        }
+    }
+}
+
+void RectifiedStereo::sweepRows(int y0, int y1, const float *ref, const float *src, int dmin, int dmax, int direction)
+{
+    const int W = w, n = (2 * r + 1) * (2 * r + 1);
+    std::vector<double> col(W);
+
+    for (int d = dmin; d <= dmax; d++){
+        const int sd = direction * d;
+
+        // Columns where both reference and shifted source exist
+        const int xa = std::max(0, -sd), xb = std::min(W - 1, W - 1 - sd);
+        if (xb - xa < 2 * r) continue;
+
+        std::fill(col.begin(), col.end(), 0.0);
+        for (int y = y0 - r; y < y0 + r; y++)
+            for (int x = xa; x <= xb; x++) col[x] += ref[y * W + x] * src[y * W + x + sd];
+
+        for (int y = y0; y < y1; y++){
+            for (int x = xa, i = (y + r) * W + xa; x <= xb; x++, i++) col[x] += ref[i] * src[i + sd];
+
+            double s = 0.0;
+            for (int x = xa; x < xa + 2 * r; x++) s += col[x];
+            for (int x = xa + r; x <= xb - r; x++){
+                s += col[x + r];
+                const int i = y * W + x, j = i + sd;
+                const float sr = refstd[i], ss = srcstd[j];
+                float ncc = -2.f;
+                if ((sr > stdthresh) && (ss > stdthresh))
+                    ncc = (s / n - (double)refmean[i] * srcmean[j]) / (sr * ss);
+
+                if (ncc > best[i]){
+                    below[i] = prevd[i] == d - 1 ? prev[i] : -2.f;
+                    above[i] = -2.f;
+                    best[i] = ncc;
+                    bestd[i] = d;
+                }
+                else if (d == bestd[i] + 1) above[i] = ncc;
+                prev[i] = ncc;
+                prevd[i] = d;
+
+                s -= col[x - r];
+            }
+
+            for (int x = xa, i = (y - r) * W + xa; x <= xb; x++, i++) col[x] -= ref[i] * src[i + sd];
+        }
+    }
+}
+
+void RectifiedStereo::compute(float *depthmap, const float *ref, const float *src, int dmin, int dmax, int direction,
+                              float fb)
+{
+    const int W = w, H = h;
+    const float QNan = std::numeric_limits<float>::quiet_NaN();
+
+    windowStats(refmean.data(), refstd.data(), ref);
+    windowStats(srcmean.data(), srcstd.data(), src);
+
+    std::fill(best.begin(), best.end(), -2.f);
+    std::fill(prev.begin(), prev.end(), -2.f);
+    std::fill(bestd.begin(), bestd.end(), -1);
+    std::fill(prevd.begin(), prevd.end(), -1);
+
+    // Split rows where window fits into bands, one per thread
+    const int rows = std::max(H - 2 * r, 0);
+    const int nthreads = std::max(1, std::min((int)std::thread::hardware_concurrency(), rows));
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nthreads; t++){
+        const int y0 = r + rows * t / nthreads, y1 = r + rows * (t + 1) / nthreads;
+        workers.push_back(std::thread(&RectifiedStereo::sweepRows, this, y0, y1, ref, src, dmin, dmax, direction));
+    }
+    for (auto & worker : workers) worker.join();
+
+    for (int i = 0; i < W * H; i++){
+        if ((bestd[i] < 0) || (best[i] < nccthresh)){
+            depthmap[i] = QNan;
+            continue;
+        }
+
+        // Parabola fit around best disparity
+        float offset = 0.f;
+        if ((below[i] > -2.f) && (above[i] > -2.f)){
+            const float denom = below[i] - 2.f * best[i] + above[i];
+            if (denom < 0.f) offset = std::min(std::max(.5f * (below[i] - above[i]) / denom, -.5f), .5f);
+        }
+
+        const float disparity = bestd[i] + offset;
+        depthmap[i] = disparity > 0.f ? fb / disparity : QNan;
+    }
+}
@@ -0,0 +1,145 @@
+#include "sgm.h"
+#include <algorithm>
+#include <limits>
+#include <climits>
+
+SGM::SGM(unsigned int width, unsigned int height, unsigned int nplanes) :
+    w(width), h(height), d(nplanes),
+    cost((size_t)width * height * nplanes, UCHAR_MAX),
+    sum((size_t)width * height * nplanes)
+{
+}
+
+CostVolumeSink SGM::sink()
+{
+    return [this](const void * data, unsigned int firstplane, unsigned int nplanes){
+        const uint8_t * slab = (const uint8_t *)data;
+        const size_t npixels = (size_t)w * h;
+        nplanes = std::min(nplanes, d - std::min(firstplane, d));
+
+        // Transpose tile by tile, so that reads of each plane are contiguous and writes stay in cache
+        for (size_t tile = 0; tile < npixels; tile += SGM_TILE_SIZE){
+            size_t end = std::min(tile + SGM_TILE_SIZE, npixels);
+            for (unsigned int k = 0; k < nplanes; k++){
+                const uint8_t * plane = slab + k * npixels;
+                uint8_t * out = cost.data() + firstplane + k;
+                for (size_t p = tile; p < end; p++) out[p * d] = plane[p];
+            }
+        }
+    };
+}
+
+void SGM::aggregate()
+{
+    std::fill(sum.begin(), sum.end(), 0);
+    aggregatePass(true);
+    aggregatePass(false);
+}
+
+void SGM::pathCost(uint16_t * __restrict Lr, const uint16_t * __restrict prev, const uint8_t * __restrict C,
+                   uint16_t * __restrict S) const
+{
+    // First pixel on path has no predecessor
+    if (!prev){
+        for (unsigned int k = 0; k < d; k++){
+            Lr[k] = C[k];
+            S[k] += C[k];
+        }
+        return;
+    }
+
+    uint16_t minprev = std::numeric_limits<uint16_t>::max();
+    for (unsigned int k = 0; k < d; k++) minprev = std::min(minprev, prev[k]);
+    const uint16_t jump = minprev + P2;
+
+    // Lr(p,d) = C(p,d) + min(Lr(p-r,d), Lr(p-r,d-1) + P1, Lr(p-r,d+1) + P1, min Lr(p-r) + P2) - min Lr(p-r)
+    // Borders are handled separately so that the main loop has no branches and can be vectorized
+    uint16_t v;
+    if (d == 1){
+        Lr[0] = C[0] + std::min(prev[0], jump) - minprev;
+        S[0] += Lr[0];
+        return;
+    }
+
+    v = std::min(std::min(prev[0], jump), (uint16_t)(prev[1] + P1));
+    Lr[0] = C[0] + v - minprev;
+    S[0] += Lr[0];
+
+    for (unsigned int k = 1; k < d - 1; k++){
+        v = std::min(std::min(prev[k], jump), (uint16_t)(std::min(prev[k - 1], prev[k + 1]) + P1));
+        Lr[k] = C[k] + v - minprev;
+        S[k] += Lr[k];
+    }
+
+    v = std::min(std::min(prev[d - 1], jump), (uint16_t)(prev[d - 2] + P1));
+    Lr[d - 1] = C[d - 1] + v - minprev;
+    S[d - 1] += Lr[d - 1];
+}
+
+void SGM::aggregatePass(bool forward)
+{
+    // Vertical path, and both diagonal paths with 8 paths, need path costs of previous row.
+    // Horizontal path only needs path costs of previous pixel.
+    const int nrowpaths = paths == 8 ? 3 : 1;
+    const size_t rowsize = (size_t)nrowpaths * w * d;
+    std::vector<uint16_t> rows(2 * rowsize);
+    std::vector<uint16_t> pixels(2 * d);
+    const int sx = forward ? 1 : -1;
+
+    for (unsigned int i = 0; i < h; i++){
+        const int y = forward ? i : h - 1 - i;
+        const uint16_t * prevrow = rows.data() + (i % 2) * rowsize;
+        uint16_t * currow = rows.data() + ((i + 1) % 2) * rowsize;
+
+        for (unsigned int j = 0; j < w; j++){
+            const int x = forward ? j : w - 1 - j;
+            const size_t p = ((size_t)y * w + x) * d;
+            const uint8_t * C = cost.data() + p;
+            uint16_t * S = sum.data() + p;
+
+            // Horizontal path
+            pathCost(pixels.data() + (j % 2) * d, j > 0 ? pixels.data() + ((j + 1) % 2) * d : nullptr, C, S);
+
+            // Vertical and diagonal paths
+            for (int r = 0; r < nrowpaths; r++){
+                const int px = x - (r == 1 ? sx : (r == 2 ? -sx : 0));
+                const uint16_t * prev = ((i > 0) && (px >= 0) && (px < (int)w)) ? prevrow + ((size_t)r * w + px) * d : nullptr;
+                pathCost(currow + ((size_t)r * w + x) * d, prev, C, S);
+            }
+        }
+    }
+}
+
+void SGM::winnerTakesAll(float * depthmap, const std::vector<float> & planes) const
+{
+    const float QNan = std::numeric_limits<float>::quiet_NaN();
+    const size_t npixels = (size_t)w * h;
+
+    for (size_t p = 0; p < npixels; p++){
+        const uint8_t * C = cost.data() + p * d;
+        const uint16_t * S = sum.data() + p * d;
+
+        unsigned int best = 0;
+        bool valid = false;
+        for (unsigned int k = 0; k < d; k++){
+            if (S[k] < S[best]) best = k;
+            valid |= C[k] < UCHAR_MAX;
+        }
+
+        if (!valid){
+            depthmap[p] = QNan;
+            continue;
+        }
+
+        // Parabola fit around minimum
+        float offset = 0.f;
+        if ((best > 0) && (best < d - 1)){
+            float denom = (float)S[best - 1] - 2.f * S[best] + S[best + 1];
+            if (denom > 0.f) offset = std::min(std::max(.5f * (S[best - 1] - (float)S[best + 1]) / denom, -.5f), .5f);
+        }
+
+        if (offset > 0.f) depthmap[p] = planes[best] + offset * (planes[best + 1] - planes[best]);
+        else if (offset < 0.f) depthmap[p] = planes[best] + offset * (planes[best] - planes[best - 1]);
+        else depthmap[p] = planes[best];
+    }
+}
@@ -0,0 +1,273 @@
+#include "tvl1.h"
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cmath>
+
+namespace {
+
+// Reusable barrier for worker threads running all iterations
+class Barrier
+{
+public:
+    explicit Barrier(int count) : count(count), waiting(0), generation(0) {}
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m);
+        const int gen = generation;
+        if (++waiting == count){
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+        }
+        else cv.wait(lock, [&]{ return gen != generation; });
+    }
+
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    int count, waiting, generation;
+};
+
+// Anisotropic diffusion tensor of guide image, same as Anisotropic_diffusion_tensor()
+void calculateTensor(float * T11, float * T12, float * T21, float * T22, const float * img, int W, int H,
+                     float beta, float gamma)
+{
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++){
+            const int i = y * W + x;
+            const int xn = std::min(x + 1, W - 1), yn = std::min(y + 1, H - 1);
+            float gx = img[y * W + xn] - img[i];
+            float gy = img[yn * W + x] - img[i];
+            const float d = std::sqrt(gx * gx + gy * gy);
+
+            // Tensor is exp(-beta*|grad(Img)|^gamma)n*trans(n) + m*trans(m), identity where there is no gradient
+            if (d > 0.f){
+                gx /= d;
+                gy /= d;
+                const float k = std::exp(-beta * std::pow(d, gamma));
+                T11[i] = k * gx * gx + gy * gy;
+                T12[i] = (k - 1) * gx * gy;
+                T21[i] = (k - 1) * gx * gy;
+                T22[i] = k * gy * gy + gx * gx;
+            }
+            else {
+                T11[i] = 1.f;
+                T12[i] = 0.f;
+                T21[i] = 0.f;
+                T22[i] = 1.f;
+            }
+        }
+}
+
+// Run iterations on bands of rows, one worker thread per band. Rows of u are row floats apart, dual(y, un, i) updates
+// dual variables of row y in iteration i using next row un and primal(y) updates primal variables of row y.
+template<class Dual, class Primal>
+void solveBands(float * u, int H, int row, unsigned int niters, const Dual & dual, const Primal & primal)
+{
+    // Split rows into bands, one per thread, each band keeps copy of first row of the next one
+    const int nthreads = std::max(1, std::min((int)std::thread::hardware_concurrency(), H / 2));
+    std::vector<int> y0(nthreads + 1);
+    for (int t = 0; t <= nthreads; t++) y0[t] = H * t / nthreads;
+    std::vector<std::vector<float>> halo(nthreads);
+    for (int t = 0; t < nthreads - 1; t++) halo[t].assign(u + y0[t + 1] * row, u + (y0[t + 1] + 1) * row);
+
+    Barrier barrier(nthreads);
+    auto band = [&](int t){
+        const int ya = y0[t], yb = y0[t + 1];
+        for (unsigned int i = 0; i < niters; i++){
+            // Dual rows and all primal rows except first one, which needs last dual row of previous band
+            for (int y = ya; y < yb; y++){
+                const float * un = y + 1 < yb ? u + (y + 1) * row : (y + 1 < H ? halo[t].data() : u + y * row);
+                dual(y, un, i);
+                if (y > ya) primal(y);
+            }
+            barrier.wait();
+
+            primal(ya);
+            if (t > 0) std::copy(u + ya * row, u + (ya + 1) * row, halo[t - 1].begin());
+            barrier.wait();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nthreads; t++) workers.push_back(std::thread(band, t));
+    for (auto & worker : workers) worker.join();
+}
+
+}
+
+TVL1Solver::TVL1Solver(unsigned int width, unsigned int height) :
+    w(width), h(height),
+    T11(width * height, 1.f), T12(width * height, 0.f), T21(width * height, 0.f), T22(width * height, 1.f),
+    Px(width * height), Py(width * height), R(width * height)
+{
+}
+
+void TVL1Solver::setTensor(const float *img, float beta, float gamma)
+{
+    calculateTensor(T11.data(), T12.data(), T21.data(), T22.data(), img, w, h, beta, gamma);
+}
+
+void TVL1Solver::dualRow(int y, const float * __restrict__ u, const float * __restrict__ un, float sigma)
+{
+    const int W = w, o = y * W;
+    float * __restrict__ px = Px.data() + o;
+    float * __restrict__ py = Py.data() + o;
+    const float * __restrict__ t11 = T11.data() + o;
+    const float * __restrict__ t12 = T12.data() + o;
+    const float * __restrict__ t21 = T21.data() + o;
+    const float * __restrict__ t22 = T22.data() + o;
+
+    auto update = [&](int x, float gx){
+        const float gy = un[x] - u[x];
+        const float dx = px[x] + sigma * (t11[x] * gx + t12[x] * gy);
+        const float dy = py[x] + sigma * (t21[x] * gx + t22[x] * gy);
+        const float d = 1.f / std::max(1.f, std::sqrt(dx * dx + dy * dy));
+        px[x] = dx * d;
+        py[x] = dy * d;
+    };
+
+    // Last column has no forward difference along x
+    for (int x = 0; x < W - 1; x++) update(x, u[x + 1] - u[x]);
+    update(W - 1, 0.f);
+}
+
+void TVL1Solver::primalRow(int y, float * __restrict__ u, const float * __restrict__ origin, float lambda, float tau,
+                           float sigma, float theta)
+{
+    const int W = w, o = y * W, op = std::max(y - 1, 0) * W;
+    const float * __restrict__ px = Px.data() + o;
+    const float * __restrict__ py = Py.data() + o;
+    const float * __restrict__ pyp = Py.data() + op;
+    float * __restrict__ r = R.data() + o;
+
+    auto update = [&](int x, float divx){
+        const float rx = std::min(std::max(r[x] + origin[x] + sigma * u[x], -lambda), lambda);
+        const float xnew = u[x] + tau * (divx + py[x] - pyp[x]) - tau * rx;
+        r[x] = rx;
+        u[x] = xnew + theta * (xnew - u[x]);
+    };
+
+    // First column has no backward difference along x
+    update(0, 0.f);
+    for (int x = 1; x < W; x++) update(x, px[x] - px[x - 1]);
+}
+
+void TVL1Solver::solve(float *u, const float *origin, unsigned int niters, float lambda, float tau, float sigma,
+                       float theta)
+{
+    const int W = w, H = h;
+    std::fill(Px.begin(), Px.end(), 0.f);
+    std::fill(Py.begin(), Py.end(), 0.f);
+    std::fill(R.begin(), R.end(), 0.f);
+    if (W * H == 0) return;
+
+    solveBands(u, H, W, niters,
+               [&](int y, const float * un, unsigned int i){ dualRow(y, u + y * W, un, i == 0 ? 1 + sigma : sigma); },
+               [&](int y){ primalRow(y, u + y * W, origin + y * W, lambda, tau, sigma, theta); });
+}
+
+TVL1BatchSolver::TVL1BatchSolver(unsigned int width, unsigned int height, unsigned int lanes) :
+    w(width), h(height), n(std::max(lanes, 1u)),
+    T11(width * height, 1.f), T12(width * height, 0.f), T21(width * height, 0.f), T22(width * height, 1.f),
+    Px(width * height * n), Py(width * height * n), R(width * height * n)
+{
+}
+
+void TVL1BatchSolver::setTensor(const float *img, float beta, float gamma)
+{
+    calculateTensor(T11.data(), T12.data(), T21.data(), T22.data(), img, w, h, beta, gamma);
+}
+
+void TVL1BatchSolver::interleave(float *output, const float * const *inputs) const
+{
+    const int N = n, WH = w * h;
+    for (int i = 0; i < WH; i++)
+        for (int k = 0; k < N; k++) output[i * N + k] = inputs[k][i];
+}
+
+void TVL1BatchSolver::deinterleave(float * const *outputs, const float *input) const
+{
+    const int N = n, WH = w * h;
+    for (int i = 0; i < WH; i++)
+        for (int k = 0; k < N; k++) outputs[k][i] = input[i * N + k];
+}
+
+void TVL1BatchSolver::dualRow(int y, const float * __restrict__ u, const float * __restrict__ un,
+                              const float * __restrict__ sigma)
+{
+    const int W = w, N = n, o = y * W;
+    float * __restrict__ px = Px.data() + o * N;
+    float * __restrict__ py = Py.data() + o * N;
+    const float * __restrict__ t11 = T11.data() + o;
+    const float * __restrict__ t12 = T12.data() + o;
+    const float * __restrict__ t21 = T21.data() + o;
+    const float * __restrict__ t22 = T22.data() + o;
+
+    // Tensor element is same for all lanes of a pixel
+    auto update = [&](int x, bool last){
+        const int i = x * N;
+        const float a11 = t11[x], a12 = t12[x], a21 = t21[x], a22 = t22[x];
+        for (int k = 0; k < N; k++){
+            const float gx = last ? 0.f : u[i + N + k] - u[i + k];
+            const float gy = un[i + k] - u[i + k];
+            const float dx = px[i + k] + sigma[k] * (a11 * gx + a12 * gy);
+            const float dy = py[i + k] + sigma[k] * (a21 * gx + a22 * gy);
+            const float d = 1.f / std::max(1.f, std::sqrt(dx * dx + dy * dy));
+            px[i + k] = dx * d;
+            py[i + k] = dy * d;
+        }
+    };
+
+    // Last column has no forward difference along x
+    for (int x = 0; x < W - 1; x++) update(x, false);
+    update(W - 1, true);
+}
+
+void TVL1BatchSolver::primalRow(int y, float * __restrict__ u, const float * __restrict__ origin,
+                                const float * __restrict__ lambda, const float * __restrict__ tau,
+                                const float * __restrict__ sigma, const float * __restrict__ theta)
+{
+    const int W = w, N = n, o = y * W * N, op = std::max(y - 1, 0) * W * N;
+    const float * __restrict__ px = Px.data() + o;
+    const float * __restrict__ py = Py.data() + o;
+    const float * __restrict__ pyp = Py.data() + op;
+    float * __restrict__ r = R.data() + o;
+
+    auto update = [&](int x, bool first){
+        const int i = x * N;
+        for (int k = 0; k < N; k++){
+            const float divx = first ? 0.f : px[i + k] - px[i - N + k];
+            const float rx = std::min(std::max(r[i + k] + origin[i + k] + sigma[k] * u[i + k], -lambda[k]), lambda[k]);
+            const float xnew = u[i + k] + tau[k] * (divx + py[i + k] - pyp[i + k]) - tau[k] * rx;
+            r[i + k] = rx;
+            u[i + k] = xnew + theta[k] * (xnew - u[i + k]);
+        }
+    };
+
+    // First column has no backward difference along x
+    update(0, true);
+    for (int x = 1; x < W; x++) update(x, false);
+}
+
+void TVL1BatchSolver::solve(float *u, const float *origin, unsigned int niters, const float *lambda, const float *tau,
+                            const float *sigma, const float *theta)
+{
+    const int W = w, H = h, N = n, row = W * N;
+    std::fill(Px.begin(), Px.end(), 0.f);
+    std::fill(Py.begin(), Py.end(), 0.f);
+    std::fill(R.begin(), R.end(), 0.f);
+    if (W * H == 0) return;
+
+    // First iteration uses larger dual step as in TVL1Solver::solve()
+    std::vector<float> firstsigma(sigma, sigma + N);
+    for (auto & s : firstsigma) s += 1.f;
+
+    solveBands(u, H, row, niters,
+               [&](int y, const float * un, unsigned int i){
+                   dualRow(y, u + y * row, un, i == 0 ? firstsigma.data() : sigma); },
+               [&](int y){ primalRow(y, u + y * row, origin + y * row, lambda, tau, sigma, theta); });
+}